@@ -3,6 +3,10 @@ import subprocess
 import re
 import os
 import sys
+import json
+import random
+import statistics
+import time
 from datetime import datetime
 
 # Configuration
@@ -11,6 +15,16 @@ BLOCK_SIZES = [64, 128]
 PROJECT_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
 EXE = os.path.join(PROJECT_ROOT, "build", "cholesky_solver")
 RESULTS_DIR = os.path.join(PROJECT_ROOT, "benchmarks", "results")
+BASELINES_DIR = os.path.join(PROJECT_ROOT, "benchmarks", "baselines")
+
+# Regression suite configuration (see `regress`)
+REGRESS_MATRIX_SIZES = [1000, 2000, 3000]
+REGRESS_BLOCK_SIZES = [64, 128]
+REGRESS_MODES = ["cholesky", "ldlt"]
+REGRESS_PHASES = ["initialization", "decomposition", "algorithm"]
+# Phases whose summed time is gated: the decomposition and the solve ("algorithm").
+# Process start-up, matrix generation and output are excluded.
+GATED_PHASES = ["decomposition", "algorithm"]
 
 def build_project():
     print("Building project...")
@@ -128,11 +142,218 @@ def compare_results(baseline_file, current_data, threshold=10.0):
         return False
     return True
 
+def parse_phase_times(output):
+    # Stage: on ldlt decomposition ns=48213377 (printed with --stage-times; the
+    # "Time:" lines are truncated to centiseconds, too coarse to gate on)
+    phases = {}
+    for match in re.finditer(r'^Stage: on ([a-z ]+) ns=(\d+)$', output, re.MULTILINE):
+        name = match.group(1)
+        if name.endswith("decomposition"):
+            name = "decomposition"
+        phases[name] = phases.get(name, 0.0) + int(match.group(2)) / 1e9
+    return phases
+
+def run_timed_case(n, m, mode):
+    """Runs one case and returns wall seconds, per-phase seconds, error and relative residual."""
+    start = time.perf_counter()
+    result = subprocess.run([EXE, f"--mode={mode}", "--stage-times", str(n), str(m)],
+                            capture_output=True, text=True)
+    wall = time.perf_counter() - start
+
+    # Error: 1.63101e-08 ; Residual: 2.50060e-08 (7.64871e-16)
+    acc_match = re.search(r'Error:\s+([eE\d\.+-]+)\s+;\s+Residual:\s+[eE\d\.+-]+\s+\(\s*([eE\d\.+-]+)\)',
+                          result.stdout)
+    if result.returncode != 0 or not acc_match:
+        raise RuntimeError(f"N={n}, M={m}, mode={mode} failed (exit code {result.returncode})")
+    return wall, parse_phase_times(result.stdout), float(acc_match.group(1)), float(acc_match.group(2))
+
+def pin_cpu(cpu):
+    """Pins this process (and the solver runs it spawns) to one CPU; returns the CPU used."""
+    if not hasattr(os, "sched_setaffinity"):
+        print("Warning: CPU affinity is not supported on this platform")
+        return None
+    if cpu is None:
+        cpu = min(os.sched_getaffinity(0))
+    os.sched_setaffinity(0, {cpu})
+    return cpu
+
+def measure_case(n, m, mode, repeats):
+    run_timed_case(n, m, mode)  # Warm-up run (page cache, CPU frequency), discarded.
+    samples = {"total": [], "phases": {phase: [] for phase in REGRESS_PHASES},
+               "error": [], "residual": []}
+    for _ in range(repeats):
+        wall, phases, error, residual = run_timed_case(n, m, mode)
+        samples["total"].append(wall)
+        for phase in REGRESS_PHASES:
+            samples["phases"][phase].append(phases.get(phase, 0.0))
+        samples["error"].append(error)
+        samples["residual"].append(residual)
+    return {"n": n, "block": m, "mode": mode, **samples}
+
+def gated_samples(case):
+    """Per-run sum of the gated phase times of a measured case."""
+    return [sum(run) for run in zip(*(case["phases"][phase] for phase in GATED_PHASES))]
+
+def worst_accuracy(case, metric):
+    """Largest error/residual over the runs of a case (older baselines store a single value)."""
+    values = case[metric]
+    return max(values) if isinstance(values, list) else values
+
+def permutation_test(baseline, current, permutations, seed):
+    """One-sided permutation test of mean(current) > mean(baseline); returns the p-value."""
+    rng = random.Random(seed)
+    observed = statistics.mean(current) - statistics.mean(baseline)
+    pooled = list(baseline) + list(current)
+    hits = 0
+    for _ in range(permutations):
+        rng.shuffle(pooled)
+        diff = statistics.mean(pooled[len(baseline):]) - statistics.mean(pooled[:len(baseline)])
+        if diff >= observed:
+            hits += 1
+    return (hits + 1) / (permutations + 1)
+
+def get_baseline_path(name):
+    return os.path.join(BASELINES_DIR, f"{name}.json")
+
+def run_regression_cases(cases, repeats, cpu):
+    build_project()
+    pinned = pin_cpu(cpu)
+    print(f"Running {len(cases)} cases x {repeats} repeats" +
+          (f" pinned to CPU {pinned}" if pinned is not None else ""))
+    measured = []
+    for n, m, mode in cases:
+        print(f"  N={n} M={m} mode={mode}...", flush=True)
+        measured.append(measure_case(n, m, mode, repeats))
+    return measured, pinned
+
+def save_baseline(name, measured, repeats, cpu):
+    os.makedirs(BASELINES_DIR, exist_ok=True)
+    try:
+        commit = subprocess.check_output(["git", "rev-parse", "--short", "HEAD"], text=True,
+                                         cwd=PROJECT_ROOT).strip()
+    except Exception:
+        commit = None
+    data = {"name": name, "commit": commit, "created": datetime.now().isoformat(timespec="seconds"),
+            "cpu": cpu, "repeats": repeats, "cases": measured}
+    with open(get_baseline_path(name), 'w') as f:
+        json.dump(data, f, indent=1)
+    print(f"\nBaseline '{name}' saved to {get_baseline_path(name)}")
+
+def compare_regression(baseline, measured, args):
+    baseline_cases = {(c["n"], c["block"], c["mode"]): c for c in baseline["cases"]}
+    print(f"\nComparing against baseline '{baseline['name']}' "
+          f"(commit {baseline.get('commit')}, {baseline['created']})")
+    header = (f"{'Matrix':<6} | {'Block':<5} | {'Mode':<8} | {'Base':>8} | {'Current':>8} | "
+              f"{'Diff %':>7} | {'p':>6} | {'Wall %':>7} | {'Residual':>9} | Status")
+    print(header)
+    print("-" * len(header))
+
+    failed = False
+    for case in measured:
+        key = (case["n"], case["block"], case["mode"])
+        if key not in baseline_cases:
+            print(f"{key[0]:<6} | {key[1]:<5} | {key[2]:<8} | {'-':>8} | "
+                  f"{statistics.median(gated_samples(case)):>7.3f}s | not in baseline")
+            continue
+        base = baseline_cases[key]
+        statuses = []
+
+        base_gated, cur_gated = gated_samples(base), gated_samples(case)
+        base_time, cur_time = statistics.median(base_gated), statistics.median(cur_gated)
+        diff_pct = ((cur_time - base_time) / base_time * 100.0) if base_time > 0 else 0.0
+        p_value = permutation_test(base_gated, cur_gated, args.permutations, args.seed)
+        base_wall, cur_wall = statistics.median(base["total"]), statistics.median(case["total"])
+        wall_pct = (cur_wall - base_wall) / base_wall * 100.0
+
+        # A slowdown of the decomposition + solve must be both statistically
+        # significant and large enough to matter; the wall time is only reported.
+        if p_value < args.alpha and diff_pct > args.min_slowdown:
+            statuses.append("REGRESSION")
+        elif diff_pct < -args.min_slowdown and \
+                permutation_test(cur_gated, base_gated, args.permutations, args.seed) < args.alpha:
+            statuses.append("IMPROVEMENT")
+
+        # Accuracy drift: the worst answer error and relative residual over all
+        # runs must stay within a factor of the baseline's worst.
+        for metric in ("error", "residual"):
+            limit = max(worst_accuracy(base, metric) * args.accuracy_factor, args.accuracy_floor)
+            if worst_accuracy(case, metric) > limit:
+                statuses.append(f"{metric.upper()} DRIFT")
+
+        if any(s != "IMPROVEMENT" for s in statuses):
+            failed = True
+        print(f"{key[0]:<6} | {key[1]:<5} | {key[2]:<8} | {base_time:>7.3f}s | {cur_time:>7.3f}s | "
+              f"{diff_pct:>+6.1f}% | {p_value:>6.3f} | {wall_pct:>+6.1f}% | "
+              f"{worst_accuracy(case, 'residual'):>9.2e} | "
+              f"{', '.join(statuses) or 'OK'}")
+
+    print("\nPer-phase medians (current, seconds):")
+    for case in measured:
+        phases = " ; ".join(f"{phase}={statistics.median(case['phases'][phase]):.4f}"
+                            for phase in REGRESS_PHASES)
+        print(f"  N={case['n']} M={case['block']} mode={case['mode']}: {phases}")
+
+    if failed:
+        print("\nFAIL: significant performance regression or accuracy drift detected!")
+        return False
+    print("\nPASS: no significant regressions.")
+    return True
+
+def parse_int_list(value):
+    return [int(v) for v in value.split(",") if v]
+
+def get_regression_cases(args):
+    sizes = parse_int_list(args.sizes) if args.sizes else REGRESS_MATRIX_SIZES
+    blocks = parse_int_list(args.blocks) if args.blocks else REGRESS_BLOCK_SIZES
+    modes = args.modes.split(",") if args.modes else REGRESS_MODES
+    return [(n, m, mode) for n in sizes for m in blocks for mode in modes if m <= n]
+
+def run_training(args):
+    """Runs every regression case once with the binary as built (profile collection for make pgo)."""
+    cases = get_regression_cases(args)
+    print(f"Training on {len(cases)} cases...")
+    for n, m, mode in cases:
+        print(f"  N={n} M={m} mode={mode}...", flush=True)
+        run_timed_case(n, m, mode)
+
+def run_regress(args):
+    cases = get_regression_cases(args)
+    path = get_baseline_path(args.baseline)
+
+    if args.record or not os.path.exists(path):
+        if not args.record:
+            print(f"No baseline '{args.baseline}' found. Recording it...")
+        measured, pinned = run_regression_cases(cases, args.repeats, args.cpu)
+        save_baseline(args.baseline, measured, args.repeats, pinned)
+        return True
+
+    with open(path) as f:
+        baseline = json.load(f)
+    measured, _ = run_regression_cases(cases, args.repeats, args.cpu)
+    return compare_regression(baseline, measured, args)
+
 if __name__ == "__main__":
     import argparse
     parser = argparse.ArgumentParser(description="Cholesky Solver Benchmark Manager")
-    parser.add_argument("command", choices=["run", "check", "save"], help="Command to run")
+    parser.add_argument("command", choices=["run", "check", "save", "regress", "train"], help="Command to run")
     parser.add_argument("--threshold", type=float, default=10.0, help="Regression threshold in %%")
+    regress = parser.add_argument_group("regress/train options")
+    regress.add_argument("--baseline", default="default", help="Name of the baseline in benchmarks/baselines")
+    regress.add_argument("--record", action="store_true", help="Record (overwrite) the named baseline")
+    regress.add_argument("--repeats", type=int, default=7, help="Timed runs per case")
+    regress.add_argument("--cpu", type=int, default=None, help="CPU to pin the runs to")
+    regress.add_argument("--sizes", help="Comma-separated matrix sizes")
+    regress.add_argument("--blocks", help="Comma-separated block sizes")
+    regress.add_argument("--modes", help="Comma-separated decomposition modes")
+    regress.add_argument("--alpha", type=float, default=0.01, help="Significance level")
+    regress.add_argument("--min-slowdown", type=float, default=2.0,
+                         help="Smallest median slowdown in %% that counts as a regression")
+    regress.add_argument("--permutations", type=int, default=5000, help="Permutations of the test")
+    regress.add_argument("--seed", type=int, default=12345, help="Seed of the permutation test")
+    regress.add_argument("--accuracy-factor", type=float, default=10.0,
+                         help="Allowed growth of the error/residual against the baseline")
+    regress.add_argument("--accuracy-floor", type=float, default=1e-14,
+                         help="Error/residual below this never count as drift")
     args = parser.parse_args()
 
     if args.command == "run":
@@ -148,3 +369,8 @@ if __name__ == "__main__":
             current = run_benchmarks(save=False)
             if not compare_results(latest, current, args.threshold):
                 sys.exit(1)
+    elif args.command == "regress":
+        if not run_regress(args):
+            sys.exit(1)
+    elif args.command == "train":
+        run_training(args)
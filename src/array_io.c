@@ -1,31 +1,14 @@
 #include "array_io.h"
 
-#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "matrix_generators.h"
 #include "matrix_utils.h"
 
 int fill_matrix(CholeskyMatrix* matrix, const double* vector_answer, double* rhs) {
-  int i, j;
-  int n = matrix->size;
-
-  for (i = 0; i < n; ++i) rhs[i] = 0;
-
-  for (i = 0; i < n; ++i) {
-    for (j = 0; j < i; j++) {
-      rhs[i] += matrix->data[get_symmetric_index(j, i, n)] * vector_answer[j];
-    }
-
-    for (j = i; j < n; j++) {
-      matrix->data[get_symmetric_index(i, j, n)] = fabs(n - j);
-
-      rhs[i] += matrix->data[get_symmetric_index(i, j, n)] * vector_answer[j];
-    }
-  }
-
-  return 0;
+  return generate_matrix(matrix, &matrix_generators[0], 0, 1, vector_answer, rhs);
 }
 
 int read_matrix(CholeskyMatrix* matrix, const double* vector_answer, double* rhs,
@@ -55,13 +38,14 @@ int read_matrix(CholeskyMatrix* matrix, const double* vector_answer, double* rhs
     }
 
     for (j = i; j < matrix_size; j++) {
-      if (fscanf(input_file, "%lf", matrix->data + get_symmetric_index(i, j, matrix_size)) != 1) {
+      if (fscanf(input_file, "%lf", &tmp) != 1) {
         printf("Error: failed to read element at (%d, %d)\n", i, j);
         fclose(input_file);
         return -3;
       }
 
-      rhs[i] += matrix->data[get_symmetric_index(i, j, matrix_size)] * vector_answer[j];
+      if (matrix->data) matrix->data[get_symmetric_index(i, j, matrix_size)] = tmp;
+      rhs[i] += tmp * vector_answer[j];
     }
   }
 
@@ -74,6 +58,51 @@ int read_matrix(CholeskyMatrix* matrix, const double* vector_answer, double* rhs
   return 0;
 }
 
+int open_matrix_rows(MatrixFileRows* rows, int size, const char* input_file_name) {
+  rows->file = fopen(input_file_name, "r");
+  rows->size = size;
+  rows->next_row = 0;
+  if (rows->file == NULL) {
+    printf("Error: cannot open input file\n");
+    return -1;
+  }
+  return 0;
+}
+
+int read_matrix_rows(void* context, int row, int count, double* rows) {
+  MatrixFileRows* source = (MatrixFileRows*)context;
+  int n = source->size;
+  int width = n - row;
+  int i, j;
+  double tmp;
+
+  if (row != source->next_row) return -1;
+
+  for (i = row; i < row + count; ++i) {
+    for (j = 0; j < i; ++j) {
+      if (fscanf(source->file, "%lf", &tmp) != 1) {
+        printf("Error: failed to read element at (%d, %d)\n", i, j);
+        return -2;
+      }
+    }
+
+    for (j = i; j < n; ++j) {
+      if (fscanf(source->file, "%lf", rows + (size_t)(i - row) * width + (j - row)) != 1) {
+        printf("Error: failed to read element at (%d, %d)\n", i, j);
+        return -3;
+      }
+    }
+  }
+
+  source->next_row = row + count;
+  return 0;
+}
+
+void close_matrix_rows(MatrixFileRows* rows) {
+  if (rows->file) fclose(rows->file);
+  rows->file = NULL;
+}
+
 void printf_matrix(const CholeskyMatrix* matrix) {
   int i, j;
   int n = matrix->size;
@@ -1,9 +1,12 @@
 #ifndef ARRAY_IO_H
 #define ARRAY_IO_H
 
+#include <stdio.h>
+
 #include "matrix_utils.h"
 
-// Fills the matrix with test data and calculates the matching RHS for a known answer.
+// Fills the matrix with the default test data (the first generator of
+// matrix_generators.h) and calculates the matching RHS for a known answer.
 //
 // Args:
 //   matrix: Pointer to the matrix structure to fill.
@@ -11,13 +14,14 @@
 //   rhs: Output buffer for the resulting right-hand side vector.
 //
 // Returns:
-//   0 on success.
+//   0 on success, non-zero on error.
 int fill_matrix(CholeskyMatrix* matrix, const double* vector_answer, double* rhs);
 
 // Reads the matrix from a file and calculates the matching RHS for a known answer.
 //
 // Args:
-//   matrix: Pointer to the matrix structure to fill.
+//   matrix: Pointer to the matrix structure to fill; with matrix->data NULL
+//     nothing is stored and only the RHS is computed.
 //   vector_answer: The known exact solution vector.
 //   rhs: Output buffer for the resulting right-hand side vector.
 //   input_file_name: Path to the matrix file.
@@ -27,6 +31,44 @@ int fill_matrix(CholeskyMatrix* matrix, const double* vector_answer, double* rhs
 int read_matrix(CholeskyMatrix* matrix, const double* vector_answer, double* rhs,
                 const char* input_file_name);
 
+// A matrix file read row by row without being stored (see read_matrix_rows()).
+typedef struct {
+  FILE* file;
+  int size;
+  int next_row;
+} MatrixFileRows;
+
+// Opens a matrix file for read_matrix_rows().
+//
+// Args:
+//   rows: Reader to initialize; release it with close_matrix_rows().
+//   size: Dimension of the matrix.
+//   input_file_name: Path to the matrix file.
+//
+// Returns:
+//   0 on success, -1 if the file cannot be opened.
+int open_matrix_rows(MatrixFileRows* rows, int size, const char* input_file_name);
+
+// Reads the rows [row, row + count) of an opened matrix file; row row + r goes
+// to rows + r * (size - row) as its columns [row, size) and the entries left of
+// the diagonal are skipped. Rows must be read in order. Matches TlrRowSource.
+//
+// Args:
+//   context: MatrixFileRows opened with open_matrix_rows().
+//   row: First row; must follow the rows already read.
+//   count: Number of rows.
+//   rows: Output buffer of count * (size - row) doubles.
+//
+// Returns:
+//   0 on success, -1 if the rows are out of order, -2/-3 on a read error.
+int read_matrix_rows(void* context, int row, int count, double* rows);
+
+// Closes a reader opened with open_matrix_rows().
+//
+// Args:
+//   rows: Reader to close.
+void close_matrix_rows(MatrixFileRows* rows);
+
 // Prints the matrix to standard output.
 //
 // Args:
@@ -0,0 +1,343 @@
+#ifndef ARRAY_KERNELS_H
+#define ARRAY_KERNELS_H
+
+// Block copy helpers and dense block kernels shared by the factorization
+// modules. Internal to the solver: everything here is static inline.
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "matrix_utils.h"
+
+// Pivots smaller than this in magnitude are treated as zero.
+extern const double EPS;
+
+// How many packed source rows ahead of the gather cursor are prefetched.
+#define GATHER_PREFETCH_DISTANCE 4
+
+// Doubles per cache line; prefetches are issued once per line.
+#define DOUBLES_PER_CACHE_LINE 8
+
+// Compiles a driver once per instruction set and picks the clone at load time
+// (make MULTIVERSION=1, the default with GCC on x86-64). The kernels below are
+// inlined into every clone, so each one gets vectorized for its ISA. FMA is not
+// enabled, so all clones round identically and results do not depend on the host.
+#if defined(CHOLESKY_MULTIVERSION) && defined(__GNUC__) && !defined(__clang__) && \
+    defined(__x86_64__)
+#define CHOLESKY_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define CHOLESKY_TARGET_CLONES
+#endif
+
+// Describes the next block pair R(row, a_column), R(row, b_column) to be gathered
+// from the packed matrix while the current pair is being multiplied.
+typedef struct {
+  const double* data;
+  int matrix_size;
+  int row;
+  int rows;
+  int a_column;
+  int a_columns;
+  int b_column;
+  int b_columns;
+  double* a;
+  double* b;
+} BlockPairGather;
+
+// Copies a block from the packed symmetric matrix to a dense square block.
+static inline void cpy_matrix_block_to_block(const double* a, int row, int column,
+                                             int matrix_size, int n, int m, double* b) {
+  int i;
+
+  // Each block row is a contiguous run of the packed row.
+  for (i = row; i < row + n; i++) {
+    memcpy(b + (size_t)(i - row) * m, a + get_symmetric_index(i, column, matrix_size),
+           m * sizeof(double));
+  }
+}
+
+// Copies a dense square block back into the packed symmetric matrix.
+static inline void cpy_block_to_matrix_block(double* a, int row, int column, int matrix_size,
+                                             int n, int m, const double* b) {
+  int i;
+
+  for (i = row; i < row + n; i++) {
+    memcpy(a + get_symmetric_index(i, column, matrix_size), b + (size_t)(i - row) * m,
+           m * sizeof(double));
+  }
+}
+
+// Copies row r of the next block pair into its buffers and prefetches the
+// source rows GATHER_PREFETCH_DISTANCE further on.
+static inline void gather_block_pair_row(const BlockPairGather* next, int r) {
+  int row = next->row + r;
+  int ahead = row + GATHER_PREFETCH_DISTANCE;
+  int p;
+
+  if (ahead < next->row + next->rows) {
+    const double* pa = next->data + get_symmetric_index(ahead, next->a_column, next->matrix_size);
+    const double* pb = next->data + get_symmetric_index(ahead, next->b_column, next->matrix_size);
+
+    for (p = 0; p < next->a_columns; p += DOUBLES_PER_CACHE_LINE) __builtin_prefetch(pa + p, 0, 3);
+    for (p = 0; p < next->b_columns; p += DOUBLES_PER_CACHE_LINE) __builtin_prefetch(pb + p, 0, 3);
+  }
+
+  memcpy(next->a + (size_t)r * next->a_columns,
+         next->data + get_symmetric_index(row, next->a_column, next->matrix_size),
+         next->a_columns * sizeof(double));
+  memcpy(next->b + (size_t)r * next->b_columns,
+         next->data + get_symmetric_index(row, next->b_column, next->matrix_size),
+         next->b_columns * sizeof(double));
+}
+
+// Performs block multiplication with diagonal scaling: C = C - A^T * D * B.
+//
+// When next is not NULL, row k of the next block pair is gathered right after
+// row k of the product has been accumulated, so the strided loads of the next
+// pair overlap with the arithmetic of the current one.
+//
+// Optimized with manual loop unrolling by 8 for high performance. Not inlined
+// into its callers, so it is multi-versioned on its own.
+CHOLESKY_TARGET_CLONES
+static inline void main_blocks_diagonal_multiply(int n, int m, int l, const double* a,
+                                                 const double* b, const double* d, double* c,
+                                                 const BlockPairGather* next) {
+  int i, j, k;
+  const double *pa, *pb;
+
+  pa = a;
+  pb = b;
+  for (k = 0; k < n; ++k) {
+    if (next && k < next->rows) gather_block_pair_row(next, k);
+
+    double pd = d[k];
+
+    for (i = 0; i < m; ++i) {
+      double ta = pa[i] * pd;
+      double* pc = c + (size_t)i * l;
+
+      for (j = 0; j < l - 7; j += 8) {
+        pc[j] -= pb[j] * ta;
+        pc[j + 1] -= pb[j + 1] * ta;
+        pc[j + 2] -= pb[j + 2] * ta;
+        pc[j + 3] -= pb[j + 3] * ta;
+        pc[j + 4] -= pb[j + 4] * ta;
+        pc[j + 5] -= pb[j + 5] * ta;
+        pc[j + 6] -= pb[j + 6] * ta;
+        pc[j + 7] -= pb[j + 7] * ta;
+      }
+
+      for (; j < l; ++j) {
+        pc[j] -= pb[j] * ta;
+      }
+    }
+
+    pa += m;
+    pb += l;
+  }
+
+  if (next) {
+    for (; k < next->rows; ++k) gather_block_pair_row(next, k);
+  }
+}
+
+// Performs standard block multiplication: C = A * B.
+//
+// Optimized with manual loop unrolling by 8 for high performance.
+static inline void main_blocks_multiply(int n, int m, int l, const double* a, const double* b,
+                                        double* c) {
+  int i, j, k;
+  const double *pa, *pb;
+
+  memset(c, 0, (size_t)m * l * sizeof(double));
+
+  pa = a;
+  pb = b;
+  for (k = 0; k < n; ++k) {
+    for (i = 0; i < m; ++i) {
+      double ta = pa[i];
+      double* pc = c + (size_t)i * l;
+
+      for (j = 0; j < l - 7; j += 8) {
+        pc[j] += pb[j] * ta;
+        pc[j + 1] += pb[j + 1] * ta;
+        pc[j + 2] += pb[j + 2] * ta;
+        pc[j + 3] += pb[j + 3] * ta;
+        pc[j + 4] += pb[j + 4] * ta;
+        pc[j + 5] += pb[j + 5] * ta;
+        pc[j + 6] += pb[j + 6] * ta;
+        pc[j + 7] += pb[j + 7] * ta;
+      }
+
+      for (; j < l; ++j) {
+        pc[j] += pb[j] * ta;
+      }
+    }
+
+    pa += m;
+    pb += l;
+  }
+}
+
+static inline void cpy_diagonal_block_to_block(const double* a, int t, int matrix_size, int m,
+                                               double* b) {
+  int i, j;
+
+  memset(b, 0, (size_t)m * m * sizeof(double));
+
+  for (i = t; i < t + m; i++) {
+    for (j = i; j < t + m; j++) {
+      b[(i - t) * m + j - t] = a[get_symmetric_index(i, j, matrix_size)];
+    }
+  }
+}
+
+static inline void cpy_block_to_diagonal_block(double* a, int t, int matrix_size, int m,
+                                               const double* b) {
+  int i, j;
+
+  for (i = t; i < t + m; i++) {
+    for (j = i; j < t + m; j++) {
+      a[get_symmetric_index(i, j, matrix_size)] = b[(i - t) * m + j - t];
+    }
+  }
+}
+
+// Inverts a triangular block with diagonal scaling.
+static inline int inverse_upper_triangle_block_and_diagonal(int n, const double* a,
+                                                            const double* d, double* b) {
+  int i, j, k;
+  double* pbi;
+
+  memset(b, 0, (size_t)n * n * sizeof(double));
+  for (i = 0; i < n; ++i) b[i * n + i] = d[i];
+
+  pbi = b + (size_t)(n - 1) * n;
+  for (i = n - 1; i >= 0; --i) {
+    if (fabs(a[i * n + i]) < EPS) return -1;
+
+    double dt = 1.0 / a[i * n + i];
+
+    for (j = i; j < n; j++) pbi[j] *= dt;
+
+    double* pbj = b;
+    const double* pa = a;
+    for (j = 0; j < i; ++j) {
+      for (k = i; k < n; ++k) {
+        pbj[k] -= pbi[k] * pa[i];
+      }
+
+      pbj += n;
+      pa += n;
+    }
+
+    pbi -= n;
+  }
+
+  return 0;
+}
+
+// Performs standard Cholesky decomposition on a small dense block.
+static inline int cholesky_for_block(int n, double* a, double* d) {
+  int i, j, k;
+  double* pai;
+
+  for (i = 0; i < n; ++i) d[i] = 1.0;
+
+  pai = a;
+  for (i = 0; i < n; ++i) {
+    double* pak = a;
+    for (k = 0; k < i; ++k) {
+      for (j = i; j < n; ++j) {
+        pai[j] -= pak[i] * d[k] * pak[j];
+      }
+
+      pak += n;
+    }
+
+    if (pai[i] < 0.0) {
+      d[i] = -1.0;
+      pai[i] = -pai[i];
+    }
+
+    pai[i] = sqrt(pai[i]);
+
+    if (fabs(pai[i]) < EPS) return -1;
+
+    // R_ii d_i R_ij = A_ij - sum_k R_ki d_k R_kj, and d_i = 1 / d_i.
+    double dt = d[i] / pai[i];
+    for (j = i + 1; j < n - 7; j += 8) {
+      pai[j] *= dt;
+      pai[j + 1] *= dt;
+      pai[j + 2] *= dt;
+      pai[j + 3] *= dt;
+      pai[j + 4] *= dt;
+      pai[j + 5] *= dt;
+      pai[j + 6] *= dt;
+      pai[j + 7] *= dt;
+    }
+
+    for (; j < n; ++j) {
+      pai[j] *= dt;
+    }
+
+    pai += n;
+  }
+
+  return 0;
+}
+
+// Gathers the first block pair R(k_begin, i), R(k_begin, j) of an update_tile()
+// into the first half of pair_buffers. Nothing is multiplied yet, so this copy
+// cannot be overlapped.
+static inline void gather_first_pair(const CholeskyMatrix* matrix, int i, int j, int rows,
+                                     int columns, int k_begin, int k_end, double* pair_buffers) {
+  int block_size = matrix->block_size;
+  int k_rows = (k_begin + block_size < k_end ? block_size : k_end - k_begin);
+
+  if (k_begin >= k_end) return;
+
+  cpy_matrix_block_to_block(matrix->data, k_begin, i, matrix->size, k_rows, rows, pair_buffers);
+  cpy_matrix_block_to_block(matrix->data, k_begin, j, matrix->size, k_rows, columns,
+                            pair_buffers + (size_t)block_size * block_size);
+}
+
+// Same as update_tile(), with the first block pair already gathered by
+// gather_first_pair().
+static inline void update_tile_gathered(const CholeskyMatrix* matrix, int i, int j, int rows,
+                                        int columns, int k_begin, int k_end,
+                                        double* pair_buffers, double* c) {
+  int block_size = matrix->block_size;
+  size_t block_elements = (size_t)block_size * block_size;
+  double* a_buffers[2] = {pair_buffers, pair_buffers + 2 * block_elements};
+  double* b_buffers[2] = {pair_buffers + block_elements, pair_buffers + 3 * block_elements};
+  int current = 0, k, k_rows;
+
+  for (k = k_begin; k < k_end; k += block_size) {
+    int next_k = k + block_size;
+    BlockPairGather next = {matrix->data, matrix->size, next_k, 0, i, rows, j, columns,
+                            a_buffers[current ^ 1], b_buffers[current ^ 1]};
+
+    k_rows = (next_k < k_end ? block_size : k_end - k);
+    if (next_k < k_end) next.rows = (next_k + block_size < k_end ? block_size : k_end - next_k);
+
+    main_blocks_diagonal_multiply(k_rows, rows, columns, a_buffers[current], b_buffers[current],
+                                  matrix->diagonal + k, c, next_k < k_end ? &next : NULL);
+    current ^= 1;
+  }
+}
+
+// Applies C = C - sum_k R(k, i)^T D_k R(k, j) over the rows k in [k_begin, k_end)
+// to the staged tile c of size rows x columns.
+//
+// The block pairs are double-buffered in pair_buffers (four blocks): while pair
+// k is multiplied, pair k + 1 is gathered into the other half.
+static inline void update_tile(const CholeskyMatrix* matrix, int i, int j, int rows,
+                               int columns, int k_begin, int k_end, double* pair_buffers,
+                               double* c) {
+  gather_first_pair(matrix, i, j, rows, columns, k_begin, k_end, pair_buffers);
+  update_tile_gathered(matrix, i, j, rows, columns, k_begin, k_end, pair_buffers, c);
+}
+
+#endif
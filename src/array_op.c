@@ -4,402 +4,356 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "array_kernels.h"
 #include "matrix_utils.h"
 
 const double EPS = 1e-16;
 
-// Copies a block from the packed symmetric matrix to a dense square block.
-static __inline__ void cpy_matrix_block_to_block(const double* a, int row, int column,
-                                                 int matrix_size, int n, int m, double* b) {
-  int i, j;
-
-  memset(b, 0, n * m * sizeof(double));
-
-  for (i = row; i < row + n; i++) {
-    for (j = column; j < column + m; ++j) {
-      b[(i - row) * m + (j - column)] = a[get_symmetric_index(i, j, matrix_size)];
-    }
-  }
-}
-
-// Copies a dense square block back into the packed symmetric matrix.
-static __inline__ void cpy_block_to_matrix_block(double* a, int row, int column, int matrix_size,
-                                                 int n, int m, const double* b) {
-  int i, j;
-
-  for (i = row; i < row + n; i++) {
-    for (j = column; j < column + m; ++j) {
-      a[get_symmetric_index(i, j, matrix_size)] = b[(i - row) * m + (j - column)];
-    }
-  }
+static int cholesky_profile_enabled = 0;
+static CholeskyProfile cholesky_profile;
+static struct timespec cholesky_profile_ts;
+
+// Charges the time since the previous tick to the given bucket.
+static void profile_tick(double* bucket) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  *bucket += (now.tv_sec - cholesky_profile_ts.tv_sec) +
+             (now.tv_nsec - cholesky_profile_ts.tv_nsec) / 1e9;
+  cholesky_profile_ts = now;
 }
 
-// Performs block multiplication with diagonal scaling: C = C - A^T * D * B.
+// The ticks sit between tiles, not inside the kernels, so the disabled check
+// costs one predictable branch per tile.
+#define PROFILE_RESET()                                      \
+  do {                                                       \
+    if (cholesky_profile_enabled) {                          \
+      memset(&cholesky_profile, 0, sizeof(cholesky_profile)); \
+      clock_gettime(CLOCK_MONOTONIC, &cholesky_profile_ts);   \
+    }                                                        \
+  } while (0)
+#define PROFILE_TICK(bucket)                                            \
+  do {                                                                  \
+    if (cholesky_profile_enabled) profile_tick(&cholesky_profile.bucket); \
+  } while (0)
+
+// Computes v = v - alpha * row over m elements.
 //
 // Optimized with manual loop unrolling by 8 for high performance.
-static inline void main_blocks_diagonal_multiply(int n, int m, int l, const double* a,
-                                                 const double* b, const double* d, double* c) {
-  int i, j, k;
-  const double *pa, *pb;
-
-  pa = a;
-  pb = b;
-  for (k = 0; k < n; ++k) {
-    double pd = d[k];
-
-    for (i = 0; i < m; ++i) {
-      double ta = pa[i] * pd;
-      double* pc = c + (size_t)i * l;
-
-      for (j = 0; j < l - 7; j += 8) {
-        pc[j] -= pb[j] * ta;
-        pc[j + 1] -= pb[j + 1] * ta;
-        pc[j + 2] -= pb[j + 2] * ta;
-        pc[j + 3] -= pb[j + 3] * ta;
-        pc[j + 4] -= pb[j + 4] * ta;
-        pc[j + 5] -= pb[j + 5] * ta;
-        pc[j + 6] -= pb[j + 6] * ta;
-        pc[j + 7] -= pb[j + 7] * ta;
-      }
-
-      for (; j < l; ++j) {
-        pc[j] -= pb[j] * ta;
-      }
-    }
-
-    pa += m;
-    pb += l;
+static inline void row_axpy(int m, double alpha, const double* row, double* v) {
+  int j;
+
+  for (j = 0; j < m - 7; j += 8) {
+    v[j] -= alpha * row[j];
+    v[j + 1] -= alpha * row[j + 1];
+    v[j + 2] -= alpha * row[j + 2];
+    v[j + 3] -= alpha * row[j + 3];
+    v[j + 4] -= alpha * row[j + 4];
+    v[j + 5] -= alpha * row[j + 5];
+    v[j + 6] -= alpha * row[j + 6];
+    v[j + 7] -= alpha * row[j + 7];
   }
+
+  for (; j < m; ++j) v[j] -= alpha * row[j];
 }
 
-// Performs standard block multiplication: C = A * B.
+// Returns the dot product of row and v over m elements.
 //
-// Optimized with manual loop unrolling by 8 for high performance.
-static inline void main_blocks_multiply(int n, int m, int l, const double* a, const double* b,
-                                        double* c) {
-  int i, j, k;
-  const double *pa, *pb;
-
-  memset(c, 0, (size_t)m * l * sizeof(double));
-
-  pa = a;
-  pb = b;
-  for (k = 0; k < n; ++k) {
-    for (i = 0; i < m; ++i) {
-      double ta = pa[i];
-      double* pc = c + (size_t)i * l;
-
-      for (j = 0; j < l - 7; j += 8) {
-        pc[j] += pb[j] * ta;
-        pc[j + 1] += pb[j + 1] * ta;
-        pc[j + 2] += pb[j + 2] * ta;
-        pc[j + 3] += pb[j + 3] * ta;
-        pc[j + 4] += pb[j + 4] * ta;
-        pc[j + 5] += pb[j + 5] * ta;
-        pc[j + 6] += pb[j + 6] * ta;
-        pc[j + 7] += pb[j + 7] * ta;
-      }
-
-      for (; j < l; ++j) {
-        pc[j] += pb[j] * ta;
-      }
-    }
-
-    pa += m;
-    pb += l;
+// Unrolled by 8 into four independent partial sums so that the additions do
+// not serialize on a single accumulator.
+static inline double row_dot(int m, const double* row, const double* v) {
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int j;
+
+  for (j = 0; j < m - 7; j += 8) {
+    s0 += row[j] * v[j] + row[j + 4] * v[j + 4];
+    s1 += row[j + 1] * v[j + 1] + row[j + 5] * v[j + 5];
+    s2 += row[j + 2] * v[j + 2] + row[j + 6] * v[j + 6];
+    s3 += row[j + 3] * v[j + 3] + row[j + 7] * v[j + 7];
   }
-}
-
-static void cpy_diagonal_block_to_block(const double* a, int t, int matrix_size, int m, double* b) {
-  int i, j;
 
-  memset(b, 0, (size_t)m * m * sizeof(double));
+  for (; j < m; ++j) s0 += row[j] * v[j];
 
-  for (i = t; i < t + m; i++) {
-    for (j = i; j < t + m; j++) {
-      b[(i - t) * m + j - t] = a[get_symmetric_index(i, j, matrix_size)];
-    }
-  }
+  return (s0 + s1) + (s2 + s3);
 }
 
-static void cpy_block_to_diagonal_block(double* a, int t, int matrix_size, int m, const double* b) {
+// Factors the block rows [row_begin, row_end) of the matrix, taking into
+// account the contributions of the rows [k_begin, row_begin) above them; the
+// contributions of rows above k_begin must already have been applied.
+CHOLESKY_TARGET_CLONES
+static int factor_block_rows(CholeskyMatrix* matrix, int k_begin, int row_begin, int row_end,
+                             double* workspace) {
   int i, j;
+  int matrix_size = matrix->size;
+  int block_size = matrix->block_size;
+  double* matrix_data = matrix->data;
+  double* diagonal = matrix->diagonal;
 
-  for (i = t; i < t + m; i++) {
-    for (j = i; j < t + m; j++) {
-      a[get_symmetric_index(i, j, matrix_size)] = b[(i - t) * m + j - t];
-    }
-  }
-}
-
-// Inverts a triangular block with diagonal scaling.
-static int inverse_upper_triangle_block_and_diagonal(int n, const double* a, const double* d,
-                                                     double* b) {
-  int i, j, k;
-  double* pbi;
-
-  memset(b, 0, (size_t)n * n * sizeof(double));
-  for (i = 0; i < n; ++i) b[i * n + i] = d[i];
-
-  pbi = b + (size_t)(n - 1) * n;
-  for (i = n - 1; i >= 0; --i) {
-    if (fabs(a[i * n + i]) < EPS) return -1;
+  double *ma, *mb, *mc, *pair_buffers;
+  size_t block_elements = (size_t)block_size * block_size;
+  ma = workspace;
+  mb = ma + block_elements;
+  pair_buffers = workspace;
+  mc = workspace + 4 * block_elements;
 
-    double dt = 1.0 / a[i * n + i];
+  for (i = row_begin; i < row_end; i += block_size) {
+    for (j = i; j < matrix_size; j += block_size) {
+      int pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+      int pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
 
-    for (j = i; j < n; j++) pbi[j] *= dt;
+      if (j != i)
+        cpy_matrix_block_to_block(matrix_data, i, j, matrix_size, pij_n, pij_m, mc);
+      else
+        cpy_diagonal_block_to_block(matrix_data, i, matrix_size, pij_n, mc);
+      gather_first_pair(matrix, i, j, pij_n, pij_m, k_begin, i, pair_buffers);
+      PROFILE_TICK(pack_seconds);
 
-    double* pbj = b;
-    const double* pa = a;
-    for (j = 0; j < i; ++j) {
-      for (k = i; k < n; ++k) {
-        pbj[k] -= pbi[k] * pa[i];
-      }
+      update_tile_gathered(matrix, i, j, pij_n, pij_m, k_begin, i, pair_buffers, mc);
+      PROFILE_TICK(update_seconds);
 
-      pbj += n;
-      pa += n;
+      if (j != i)
+        cpy_block_to_matrix_block(matrix_data, i, j, matrix_size, pij_n, pij_m, mc);
+      else
+        cpy_block_to_diagonal_block(matrix_data, i, matrix_size, pij_n, mc);
+      PROFILE_TICK(pack_seconds);
     }
 
-    pbi -= n;
-  }
-
-  return 0;
-}
-
-// Performs standard Cholesky decomposition on a small dense block.
-static int cholesky_for_block(int n, double* a, double* d) {
-  int i, j, k;
-  double* pai;
-
-  for (i = 0; i < n; ++i) d[i] = 1.0;
-
-  pai = a;
-  for (i = 0; i < n; ++i) {
-    double* pak = a;
-    for (k = 0; k < i; ++k) {
-      for (j = i; j < n; ++j) {
-        pai[j] -= pak[i] * d[k] * pak[j];
-      }
+    int pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
 
-      pak += n;
-    }
+    cpy_diagonal_block_to_block(matrix_data, i, matrix_size, pij_n, mb);
 
-    if (pai[i] < 0.0) {
-      d[i] = -1.0;
-      pai[i] = -pai[i];
-    }
+    if (cholesky_for_block(pij_n, mb, diagonal + i)) return -1;
 
-    pai[i] = sqrt(pai[i]);
+    cpy_block_to_diagonal_block(matrix_data, i, matrix_size, pij_n, mb);
 
-    if (fabs(pai[i]) < EPS) return -1;
+    if (inverse_upper_triangle_block_and_diagonal(pij_n, mb, diagonal + i, ma)) return -1;
 
-    double dt = 1.0 / pai[i];
-    for (j = i + 1; j < n - 7; j += 8) {
-      pai[j] *= dt;
-      pai[j + 1] *= dt;
-      pai[j + 2] *= dt;
-      pai[j + 3] *= dt;
-      pai[j + 4] *= dt;
-      pai[j + 5] *= dt;
-      pai[j + 6] *= dt;
-      pai[j + 7] *= dt;
-    }
+    for (j = i + block_size; j < matrix_size; j += block_size) {
+      int cur_pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+      int cur_pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
 
-    for (; j < n; ++j) {
-      pai[j] *= dt;
+      cpy_matrix_block_to_block(matrix_data, i, j, matrix_size, cur_pij_n, cur_pij_m, mb);
+      main_blocks_multiply(cur_pij_n, cur_pij_n, cur_pij_m, ma, mb, mc);
+      cpy_block_to_matrix_block(matrix_data, i, j, matrix_size, cur_pij_n, cur_pij_m, mc);
     }
-
-    pai += n;
+    PROFILE_TICK(factor_seconds);
   }
 
   return 0;
 }
 
-static int inverse_upper_triangle_block_and_diagonal_rhs(int n, const double* a, const double* d,
-                                                         double* rhs) {
-  int i, j;
+int cholesky(CholeskyMatrix* matrix, double* workspace) {
+  PROFILE_RESET();
 
-  for (i = 0; i < n; ++i) rhs[i] *= d[i];
+  return factor_block_rows(matrix, 0, 0, matrix->size, workspace);
+}
 
-  for (i = n - 1; i >= 0; --i) {
-    if (fabs(a[i * n + i]) < EPS) return -1;
+CHOLESKY_TARGET_CLONES
+int cholesky_partial(CholeskyMatrix* matrix, int stop_row, double* workspace) {
+  int i, j;
+  int matrix_size = matrix->size;
+  int block_size = matrix->block_size;
+  double* pair_buffers = workspace;
+  double* mc = workspace + 4 * (size_t)block_size * block_size;
 
-    rhs[i] *= 1.0 / a[i * n + i];
+  if (stop_row < 0 || stop_row > matrix_size ||
+      (stop_row % block_size != 0 && stop_row != matrix_size))
+    return -2;
 
-    for (j = 0; j < i; ++j) {
-      rhs[j] -= rhs[i] * a[j * n + i];
-    }
-  }
+  PROFILE_RESET();
 
-  return 0;
-}
+  if (factor_block_rows(matrix, 0, 0, stop_row, workspace)) return -1;
 
-static int inverse_lower_triangle_block_rhs(int n, const double* a, double* rhs) {
-  int i, j;
+  // Apply the eliminated rows to the trailing tiles: A22 - R12^T D1 R12 = S.
+  for (i = stop_row; i < matrix_size; i += block_size) {
+    for (j = i; j < matrix_size; j += block_size) {
+      int pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+      int pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
 
-  for (i = 0; i < n; ++i) {
-    if (fabs(a[i * n + i]) < EPS) return -1;
+      if (j != i)
+        cpy_matrix_block_to_block(matrix->data, i, j, matrix_size, pij_n, pij_m, mc);
+      else
+        cpy_diagonal_block_to_block(matrix->data, i, matrix_size, pij_n, mc);
 
-    rhs[i] *= 1.0 / a[i * n + i];
+      update_tile(matrix, i, j, pij_n, pij_m, 0, stop_row, pair_buffers, mc);
 
-    for (j = i + 1; j < n; ++j) {
-      rhs[j] -= rhs[i] * a[i * n + j];
+      if (j != i)
+        cpy_block_to_matrix_block(matrix->data, i, j, matrix_size, pij_n, pij_m, mc);
+      else
+        cpy_block_to_diagonal_block(matrix->data, i, matrix_size, pij_n, mc);
     }
   }
+  PROFILE_TICK(update_seconds);
 
   return 0;
 }
 
-static void matrix_block_vector_multiply(int n, int m, const double* a, const double* b,
-                                         double* c) {
-  int i, j;
-  const double* pai;
-
-  pai = a;
-  for (i = 0; i < n; i++) {
-    for (j = 0; j < m; j++) {
-      c[i] -= pai[j] * b[j];
-    }
-
-    pai += m;
-  }
+const double* get_schur_complement(const CholeskyMatrix* matrix, int start_row) {
+  return matrix->data + get_symmetric_index(start_row, start_row, matrix->size);
 }
 
-static void matrix_block_transposed_vector_multiply(int n, int m, const double* a, const double* b,
-                                                    double* c) {
-  int i, j;
+int cholesky_resume(CholeskyMatrix* matrix, int start_row, double* workspace) {
+  if (start_row < 0 || start_row > matrix->size ||
+      (start_row % matrix->block_size != 0 && start_row != matrix->size))
+    return -2;
 
-  for (i = 0; i < m; i++) {
-    for (j = 0; j < n; j++) {
-      c[i] -= a[j * m + i] * b[j];
-    }
-  }
+  PROFILE_RESET();
+
+  return factor_block_rows(matrix, start_row, start_row, matrix->size, workspace);
 }
 
-int cholesky(CholeskyMatrix* matrix, double* workspace) {
-  int i, j, k;
+// Computes the columns [column_begin, size) of the already factored rows
+// [0, column_begin), whose blocks left of column_begin are final.
+CHOLESKY_TARGET_CLONES
+static int factor_border_columns(CholeskyMatrix* matrix, int column_begin, double* workspace) {
+  int i, j;
   int matrix_size = matrix->size;
   int block_size = matrix->block_size;
   double* matrix_data = matrix->data;
-  double* diagonal = matrix->diagonal;
 
-  double *ma, *mb, *mc;
+  double *ma, *mb, *mc, *pair_buffers;
+  size_t block_elements = (size_t)block_size * block_size;
   ma = workspace;
-  mb = ma + (size_t)block_size * block_size;
-  mc = mb + (size_t)block_size * block_size;
+  mb = ma + block_elements;
+  pair_buffers = workspace;
+  mc = workspace + 4 * block_elements;
 
-  for (i = 0; i < matrix_size; i += block_size) {
-    for (j = i; j < matrix_size; j += block_size) {
-      int pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
-      int pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
-
-      if (j != i)
-        cpy_matrix_block_to_block(matrix_data, i, j, matrix_size, pij_n, pij_m, mc);
-      else
-        cpy_diagonal_block_to_block(matrix_data, i, matrix_size, pij_n, mc);
+  for (i = 0; i < column_begin; i += block_size) {
+    int pij_n = (i + block_size < column_begin ? block_size : column_begin - i);
 
-      for (k = 0; k < i; k += block_size) {
-        int pki_n = (k + block_size < matrix_size ? block_size : matrix_size - k);
-        int pki_m = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    for (j = column_begin; j < matrix_size; j += block_size) {
+      int pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
 
-        int pkj_n = (k + block_size < matrix_size ? block_size : matrix_size - k);
-        int pkj_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
+      cpy_matrix_block_to_block(matrix_data, i, j, matrix_size, pij_n, pij_m, mc);
+      update_tile(matrix, i, j, pij_n, pij_m, 0, i, pair_buffers, mc);
+      cpy_block_to_matrix_block(matrix_data, i, j, matrix_size, pij_n, pij_m, mc);
+    }
 
-        cpy_matrix_block_to_block(matrix_data, k, i, matrix_size, pki_n, pki_m, ma);
-        cpy_matrix_block_to_block(matrix_data, k, j, matrix_size, pkj_n, pkj_m, mb);
+    // R_ii and D_i are final; only their inverse has to be rebuilt.
+    cpy_diagonal_block_to_block(matrix_data, i, matrix_size, pij_n, mb);
+    if (inverse_upper_triangle_block_and_diagonal(pij_n, mb, matrix->diagonal + i, ma)) return -1;
 
-        main_blocks_diagonal_multiply(pki_n, pki_m, pkj_m, ma, mb, diagonal + k, mc);
-      }
+    for (j = column_begin; j < matrix_size; j += block_size) {
+      int pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
 
-      if (j != i)
-        cpy_block_to_matrix_block(matrix_data, i, j, matrix_size, pij_n, pij_m, mc);
-      else
-        cpy_block_to_diagonal_block(matrix_data, i, matrix_size, pij_n, mc);
+      cpy_matrix_block_to_block(matrix_data, i, j, matrix_size, pij_n, pij_m, mb);
+      main_blocks_multiply(pij_n, pij_n, pij_m, ma, mb, mc);
+      cpy_block_to_matrix_block(matrix_data, i, j, matrix_size, pij_n, pij_m, mc);
     }
+  }
 
-    int pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+  return 0;
+}
 
-    cpy_diagonal_block_to_block(matrix_data, i, matrix_size, pij_n, mb);
+int cholesky_extend(CholeskyMatrix* matrix, int border_count, const double* border,
+                    double* workspace) {
+  int i, c;
+  int old_size = matrix->size;
+  int new_size = old_size + border_count;
+  double* data;
+  double* diagonal;
+
+  // A cached factor lives inside an mmap()ed file and cannot be realloc()ed.
+  if (border_count <= 0 || matrix->mapped) return -2;
+
+  data = (double*)realloc(matrix->data, get_symmetric_matrix_size(new_size) * sizeof(double));
+  if (!data) return -2;
+  matrix->data = data;
+
+  diagonal = (double*)realloc(matrix->diagonal, new_size * sizeof(double));
+  if (!diagonal) return -2;
+  matrix->diagonal = diagonal;
+
+  // Every packed row gets longer, so the rows move towards the end of the
+  // storage; starting from the last one never overwrites a row not yet moved.
+  for (i = old_size - 1; i > 0; --i) {
+    memmove(data + get_symmetric_index(i, i, new_size), data + get_symmetric_index(i, i, old_size),
+            (old_size - i) * sizeof(double));
+  }
 
-    if (cholesky_for_block(pij_n, mb, diagonal + i)) return -1;
+  // Scatter the border: A(r, old_size + c) for the old rows, then the new rows.
+  for (c = 0; c < border_count; ++c) {
+    const double* border_row = border + (size_t)c * new_size;
+    int row = old_size + c;
 
-    cpy_block_to_diagonal_block(matrix_data, i, matrix_size, pij_n, mb);
+    for (i = 0; i < old_size; ++i) data[get_symmetric_index(i, row, new_size)] = border_row[i];
+    memcpy(data + get_symmetric_index(row, row, new_size), border_row + row,
+           (new_size - row) * sizeof(double));
+  }
+  matrix->size = new_size;
 
-    if (inverse_upper_triangle_block_and_diagonal(pij_n, mb, diagonal + i, ma)) return -1;
+  PROFILE_RESET();
 
-    for (j = i + block_size; j < matrix_size; j += block_size) {
-      int cur_pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
-      int cur_pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
+  if (factor_border_columns(matrix, old_size, workspace)) return -1;
 
-      cpy_matrix_block_to_block(matrix_data, i, j, matrix_size, cur_pij_n, cur_pij_m, mb);
-      main_blocks_multiply(cur_pij_n, cur_pij_n, cur_pij_m, ma, mb, mc);
-      cpy_block_to_matrix_block(matrix_data, i, j, matrix_size, cur_pij_n, cur_pij_m, mc);
-    }
-  }
+  return factor_block_rows(matrix, 0, old_size, new_size, workspace);
+}
 
-  return 0;
+void set_cholesky_profiling(int enabled) {
+  cholesky_profile_enabled = enabled;
 }
 
-int solve_lower_triangle_matrix_system(const CholeskyMatrix* matrix, double* rhs,
-                                       double* workspace) {
-  int i, j;
-  int matrix_size = matrix->size;
-  int block_size = matrix->block_size;
-  const double* matrix_data = matrix->data;
-  double* ma;
-  ma = workspace;
+void get_cholesky_profile(CholeskyProfile* profile) {
+  *profile = cholesky_profile;
+}
 
-  for (i = 0; i < matrix_size; i += block_size) {
-    int pii_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+size_t get_cholesky_workspace_size(int block_size) {
+  return 5 * (size_t)block_size * block_size;
+}
 
-    cpy_diagonal_block_to_block(matrix_data, i, matrix_size, pii_n, ma);
+int solve_lower_triangle_matrix_system(const CholeskyMatrix* matrix, double* rhs) {
+  return solve_lower_triangle_matrix_system_multi(matrix, rhs, 1);
+}
 
-    if (inverse_lower_triangle_block_rhs(pii_n, ma, rhs + i)) return -1;
+CHOLESKY_TARGET_CLONES
+int solve_lower_triangle_matrix_system_multi(const CholeskyMatrix* matrix, double* rhs,
+                                             int rhs_count) {
+  int i, r;
+  int matrix_size = matrix->size;
+  const double* row = matrix->data;
 
-    for (j = i + block_size; j < matrix_size; j += block_size) {
-      int pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
-      int pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
+  // Column i of R^T is packed row i: y_i = b_i / R_ii, then b -= y_i R(i, i+1:).
+  for (i = 0; i < matrix_size; ++i) {
+    int length = matrix_size - i;
 
-      cpy_matrix_block_to_block(matrix_data, i, j, matrix_size, pij_n, pij_m, ma);
+    if (fabs(row[0]) < EPS) return -1;
 
-      matrix_block_transposed_vector_multiply(pij_n, pij_m, ma, rhs + i, rhs + j);
+    for (r = 0; r < rhs_count; ++r) {
+      double* v = rhs + (size_t)r * matrix_size + i;
+      v[0] /= row[0];
+      row_axpy(length - 1, v[0], row + 1, v + 1);
     }
+
+    row += length;
   }
 
   return 0;
 }
 
-int solve_upper_triangle_matrix_diagonal_system(const CholeskyMatrix* matrix, double* rhs,
-                                                double* workspace) {
-  int i, j;
+int solve_upper_triangle_matrix_diagonal_system(const CholeskyMatrix* matrix, double* rhs) {
+  return solve_upper_triangle_matrix_diagonal_system_multi(matrix, rhs, 1);
+}
+
+CHOLESKY_TARGET_CLONES
+int solve_upper_triangle_matrix_diagonal_system_multi(const CholeskyMatrix* matrix, double* rhs,
+                                                      int rhs_count) {
+  int i, r;
   int matrix_size = matrix->size;
-  int block_size = matrix->block_size;
-  const double* matrix_data = matrix->data;
   const double* diagonal = matrix->diagonal;
-  int residue;
-  double* ma;
-
-  ma = workspace;
+  const double* row = matrix->data + get_symmetric_matrix_size(matrix_size);
 
-  residue = matrix_size - (matrix_size % block_size);
-  if (residue == matrix_size) residue -= block_size;
+  // Packed rows from the last one up: x_i = (d_i y_i - R(i, i+1:) x(i+1:)) / R_ii.
+  for (i = matrix_size - 1; i >= 0; --i) {
+    int length = matrix_size - i;
 
-  for (i = residue; i >= 0; i -= block_size) {
-    for (j = residue; j > i; j -= block_size) {
-      int pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
-      int pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
+    row -= length;
+    if (fabs(row[0]) < EPS) return -1;
 
-      cpy_matrix_block_to_block(matrix_data, i, j, matrix_size, pij_n, pij_m, ma);
-
-      matrix_block_vector_multiply(pij_n, pij_m, ma, rhs + j, rhs + i);
+    for (r = 0; r < rhs_count; ++r) {
+      double* v = rhs + (size_t)r * matrix_size + i;
+      v[0] = (diagonal[i] * v[0] - row_dot(length - 1, row + 1, v + 1)) / row[0];
     }
-
-    int pii_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
-
-    cpy_diagonal_block_to_block(matrix_data, i, matrix_size, pii_n, ma);
-
-    if (inverse_upper_triangle_block_and_diagonal_rhs(pii_n, ma, diagonal + i, rhs + i)) return -1;
   }
 
   return 0;
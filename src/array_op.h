@@ -1,40 +1,175 @@
 #ifndef ARRAY_OP_H
 #define ARRAY_OP_H
 
+#include <stddef.h>
+
 #include "matrix_utils.h"
 
+// Time split of the last serial decomposition (cholesky() and its variants;
+// cholesky_parallel() does not record one). Only filled in while profiling is
+// enabled with set_cholesky_profiling(); otherwise all zeros.
+//
+// The gathers of block pairs 2..K of an update are interleaved row by row with
+// the multiplication of the previous pair and are not timed on their own: they
+// count as update, so pack_seconds is the exposed packing only.
+typedef struct {
+  // Gathers/scatters that cannot be overlapped: staging each tile in and out
+  // and the first block pair of its update.
+  double pack_seconds;
+  double update_seconds;  // Trailing updates, including the gathers overlapped with them.
+  double factor_seconds;  // Diagonal block factorization and row scaling.
+} CholeskyProfile;
+
+// Returns the number of doubles of workspace required by cholesky() and its variants.
+//
+// Args:
+//   block_size: Block size of the matrix.
+size_t get_cholesky_workspace_size(int block_size);
+
 // Performs the block Cholesky decomposition A = R^T D R.
 //
 // Args:
 //   matrix: Pointer to the CholeskyMatrix structure.
-//   workspace: Pre-allocated memory for intermediate block operations.
+//   workspace: Pre-allocated memory for intermediate block operations
+//     (get_cholesky_workspace_size() doubles).
 //
 // Returns:
 //   0 on success, -1 if the matrix is singular or not positive definite.
 int cholesky(CholeskyMatrix* matrix, double* workspace);
 
+// Eliminates the leading stop_row rows and leaves the Schur complement in place.
+//
+// On return rows [0, stop_row) hold R11, R12 and D1 exactly as cholesky()
+// would compute them, and the trailing rows hold
+// S = A22 - A12^T A11^{-1} A12 = A22 - R12^T D1 R12 (see get_schur_complement()).
+//
+// Args:
+//   matrix: Pointer to the CholeskyMatrix structure.
+//   stop_row: Number of rows to eliminate; a multiple of the block size (or the matrix size).
+//   workspace: get_cholesky_workspace_size() doubles.
+//
+// Returns:
+//   0 on success, -1 if the leading block is singular, -2 if stop_row is invalid.
+int cholesky_partial(CholeskyMatrix* matrix, int stop_row, double* workspace);
+
+// Returns the Schur complement left by cholesky_partial(matrix, start_row, ...).
+//
+// The trailing rows of the packed storage are themselves a packed upper
+// triangle, so S is returned in place as a read-only packed matrix of size
+// matrix->size - start_row. A caller that modifies S before cholesky_resume()
+// writes it through matrix->data from get_symmetric_index(start_row, start_row, size).
+//
+// Args:
+//   matrix: Partially decomposed matrix.
+//   start_row: Number of eliminated rows.
+const double* get_schur_complement(const CholeskyMatrix* matrix, int start_row);
+
+// Completes a decomposition started by cholesky_partial() by factoring the
+// (possibly modified) Schur complement in the trailing rows.
+//
+// With an unmodified Schur complement the result is bitwise identical to a
+// single cholesky() call: the updates are accumulated in the same order.
+//
+// Args:
+//   matrix: Partially decomposed matrix.
+//   start_row: Number of rows eliminated by cholesky_partial().
+//   workspace: get_cholesky_workspace_size() doubles.
+//
+// Returns:
+//   0 on success, -1 if the Schur complement is singular, -2 if start_row is invalid.
+int cholesky_resume(CholeskyMatrix* matrix, int start_row, double* workspace);
+
+// Grows a decomposed matrix by border_count rows and columns.
+//
+// The leading rows of R and D do not depend on the new unknowns, so only the
+// new columns of the old rows and the new trailing rows are computed, in
+// O(N^2 p) instead of the O(N^3) of a new decomposition. The packed storage
+// is reallocated to the new size and the old rows are moved in place. If the
+// old size is a multiple of the block size the result is bitwise identical to
+// cholesky() on the extended matrix.
+//
+// Args:
+//   matrix: Decomposed matrix; data and diagonal must come from malloc(), a
+//     factor mapped by factor_cache_load() (matrix->mapped) is rejected.
+//   border_count: Number of rows and columns to append.
+//   border: Rows [size, size + border_count) of the extended symmetric A,
+//     border_count rows of (size + border_count) values each. Row c supplies
+//     the new column A(0:size, size + c) and the upper part of the new row;
+//     the entries left of its diagonal among the new columns are not read.
+//   workspace: get_cholesky_workspace_size() doubles.
+//
+// Returns:
+//   0 on success, -1 if the extended matrix is singular (the matrix is then
+//   left partially extended), -2 if border_count is invalid, the storage is
+//   mapped or could not be grown (the matrix is then unchanged).
+int cholesky_extend(CholeskyMatrix* matrix, int border_count, const double* border,
+                    double* workspace);
+
+// Enables or disables the recording of the CholeskyProfile (off by default).
+//
+// Args:
+//   enabled: Non-zero to time the following decompositions.
+void set_cholesky_profiling(int enabled);
+
+// Copies the time split of the last cholesky() call.
+//
+// Args:
+//   profile: Output structure.
+void get_cholesky_profile(CholeskyProfile* profile);
+
 // Solves the system R^T y = b using forward substitution.
 //
+// The packed rows of R are the columns of R^T in the order the sweep needs
+// them, so the factor is streamed straight from the packed storage without
+// staging any blocks.
+//
 // Args:
 //   matrix: Decomposed matrix structure.
 //   rhs: The right-hand side vector (modified in-place to solution y).
-//   workspace: Pre-allocated block workspace.
 //
 // Returns:
 //   0 on success, non-zero on error.
-int solve_lower_triangle_matrix_system(const CholeskyMatrix* matrix, double* rhs,
-                                       double* workspace);
+int solve_lower_triangle_matrix_system(const CholeskyMatrix* matrix, double* rhs);
+
+// Solves R^T Y = B for several right-hand sides at once.
+//
+// Each packed row of R is applied to every right-hand side before moving on,
+// so it is fetched from memory once per batch and from cache otherwise.
+//
+// Args:
+//   matrix: Decomposed matrix structure.
+//   rhs: rhs_count vectors of length matrix->size stored one after another
+//     (modified in-place to the solutions Y).
+//   rhs_count: Number of right-hand sides.
+//
+// Returns:
+//   0 on success, non-zero on error.
+int solve_lower_triangle_matrix_system_multi(const CholeskyMatrix* matrix, double* rhs,
+                                             int rhs_count);
 
 // Solves the system D R x = y using backward substitution.
 //
+// Streams the packed rows of R from the last one to the first.
+//
 // Args:
 //   matrix: Decomposed matrix structure (including diagonal D).
 //   rhs: The right-hand side vector y (modified in-place to solution x).
-//   workspace: Pre-allocated block workspace.
 //
 // Returns:
 //   0 on success, non-zero on error.
-int solve_upper_triangle_matrix_diagonal_system(const CholeskyMatrix* matrix, double* rhs,
-                                                double* workspace);
+int solve_upper_triangle_matrix_diagonal_system(const CholeskyMatrix* matrix, double* rhs);
+
+// Solves D R X = Y for several right-hand sides at once.
+//
+// Args:
+//   matrix: Decomposed matrix structure (including diagonal D).
+//   rhs: rhs_count vectors of length matrix->size stored one after another
+//     (modified in-place to the solutions X).
+//   rhs_count: Number of right-hand sides.
+//
+// Returns:
+//   0 on success, non-zero on error.
+int solve_upper_triangle_matrix_diagonal_system_multi(const CholeskyMatrix* matrix, double* rhs,
+                                                      int rhs_count);
 
 #endif
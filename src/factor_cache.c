@@ -0,0 +1,243 @@
+#include "factor_cache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "matrix_utils.h"
+
+static const char FACTOR_CACHE_MAGIC[8] = "CHOLFAC";
+static const char FACTOR_CACHE_SUFFIX[] = ".fac";
+
+// On-disk header; the packed factor, the diagonal D and (for the pivoted
+// LDL^T mode) the pivot indices follow it directly.
+typedef struct {
+  char magic[8];
+  uint32_t layout_version;
+  int32_t size;
+  int32_t block_size;
+  int32_t pivoting;  // Non-zero if n pivot indices (int32) follow the diagonal.
+  uint64_t key;
+  uint64_t digest;  // Independent hash of the input, checked on load.
+} FactorCacheHeader;
+
+typedef struct {
+  char* path;
+  time_t mtime;
+  size_t size;
+} FactorCacheEntry;
+
+// Mixes the word at the given position into the digest: a splitmix64
+// finalizer over the position-keyed word, accumulated as a polynomial, which
+// shares no structure with the FNV-style key.
+static inline uint64_t digest_word(uint64_t digest, uint64_t word, uint64_t position) {
+  uint64_t z = word ^ (position * 0xd6e8feb86659fd93ULL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z ^= z >> 31;
+  return digest * 0x9e3779b97f4a7c15ULL + z;
+}
+
+FactorCacheKey factor_cache_key(const CholeskyMatrix* matrix) {
+  size_t count = get_symmetric_matrix_size(matrix->size);
+  uint64_t header[4] = {(uint64_t)matrix->size, (uint64_t)matrix->block_size,
+                        FACTOR_CACHE_LAYOUT_VERSION, matrix->pivots != NULL};
+  uint64_t hash = HASH_SEED, digest = 0;
+  FactorCacheKey key;
+  size_t i;
+
+  for (i = 0; i < 4; ++i) {
+    hash = hash_word(hash, header[i]);
+    digest = digest_word(digest, header[i], i);
+  }
+
+  for (i = 0; i < count; ++i) {
+    uint64_t word;
+    memcpy(&word, matrix->data + i, sizeof(word));
+    hash = hash_word(hash, word);
+    digest = digest_word(digest, word, i + 4);
+  }
+
+  key.key = hash_finalize(hash);
+  key.digest = digest;
+  return key;
+}
+
+static size_t get_payload_bytes(int n, int pivoting) {
+  return (get_symmetric_matrix_size(n) + (size_t)n) * sizeof(double) +
+         (pivoting ? (size_t)n * sizeof(int32_t) : 0);
+}
+
+static void get_entry_path(const char* cache_dir, uint64_t key, char* path, size_t path_size) {
+  snprintf(path, path_size, "%s/%016llx%s", cache_dir, (unsigned long long)key,
+           FACTOR_CACHE_SUFFIX);
+}
+
+int factor_cache_load(const char* cache_dir, FactorCacheKey key, CholeskyMatrix* matrix,
+                      FactorCacheMapping* mapping) {
+  char path[4096];
+  struct stat st;
+  FactorCacheHeader header;
+  int pivoting = matrix->pivots != NULL;
+  size_t expected_length = sizeof(FactorCacheHeader) + get_payload_bytes(matrix->size, pivoting);
+  int fd;
+  void* base;
+
+  mapping->base = NULL;
+  mapping->length = 0;
+
+  get_entry_path(cache_dir, key.key, path, sizeof(path));
+  fd = open(path, O_RDONLY);
+  if (fd < 0) return 1;
+
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size != expected_length ||
+      read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+      memcmp(header.magic, FACTOR_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.layout_version != FACTOR_CACHE_LAYOUT_VERSION || header.size != matrix->size ||
+      header.block_size != matrix->block_size || header.pivoting != pivoting ||
+      header.key != key.key || header.digest != key.digest) {
+    close(fd);
+    return 1;
+  }
+
+  // Private mapping: callers may scribble over the factor without touching the file.
+  base = mmap(NULL, expected_length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return 1;
+
+  // Refresh the modification time so that eviction sees this entry as recently used.
+  utimes(path, NULL);
+
+  mapping->base = base;
+  mapping->length = expected_length;
+  matrix->data = (double*)((char*)base + sizeof(FactorCacheHeader));
+  matrix->diagonal = matrix->data + get_symmetric_matrix_size(matrix->size);
+  if (pivoting) matrix->pivots = (int*)(matrix->diagonal + matrix->size);
+  matrix->mapped = 1;
+
+  return 0;
+}
+
+static int compare_entries_by_mtime(const void* lhs, const void* rhs) {
+  const FactorCacheEntry* a = (const FactorCacheEntry*)lhs;
+  const FactorCacheEntry* b = (const FactorCacheEntry*)rhs;
+  return (a->mtime > b->mtime) - (a->mtime < b->mtime);
+}
+
+// Removes the least recently used entries until the directory fits into max_bytes.
+// The entry at keep_path is never evicted.
+static void evict_entries(const char* cache_dir, const char* keep_path, size_t max_bytes) {
+  DIR* dir;
+  struct dirent* dirent;
+  FactorCacheEntry* entries = NULL;
+  size_t entry_count = 0, entry_capacity = 0, total_bytes = 0, i;
+  size_t suffix_length = strlen(FACTOR_CACHE_SUFFIX);
+
+  dir = opendir(cache_dir);
+  if (dir == NULL) return;
+
+  while ((dirent = readdir(dir)) != NULL) {
+    size_t name_length = strlen(dirent->d_name);
+    char path[4096];
+    struct stat st;
+
+    if (name_length <= suffix_length ||
+        strcmp(dirent->d_name + name_length - suffix_length, FACTOR_CACHE_SUFFIX) != 0)
+      continue;
+
+    snprintf(path, sizeof(path), "%s/%s", cache_dir, dirent->d_name);
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+
+    if (entry_count == entry_capacity) {
+      size_t new_capacity = entry_capacity ? 2 * entry_capacity : 16;
+      FactorCacheEntry* grown =
+          (FactorCacheEntry*)realloc(entries, new_capacity * sizeof(FactorCacheEntry));
+      if (!grown) break;
+      entries = grown;
+      entry_capacity = new_capacity;
+    }
+
+    entries[entry_count].path = strdup(path);
+    entries[entry_count].mtime = st.st_mtime;
+    entries[entry_count].size = (size_t)st.st_size;
+    if (!entries[entry_count].path) break;
+    total_bytes += entries[entry_count].size;
+    entry_count++;
+  }
+  closedir(dir);
+
+  qsort(entries, entry_count, sizeof(FactorCacheEntry), compare_entries_by_mtime);
+
+  for (i = 0; i < entry_count && total_bytes > max_bytes; ++i) {
+    if (strcmp(entries[i].path, keep_path) == 0) continue;
+    if (unlink(entries[i].path) == 0) total_bytes -= entries[i].size;
+  }
+
+  for (i = 0; i < entry_count; ++i) free(entries[i].path);
+  free(entries);
+}
+
+static int write_all(int fd, const void* buffer, size_t length) {
+  const char* p = (const char*)buffer;
+
+  while (length > 0) {
+    ssize_t written = write(fd, p, length);
+    if (written <= 0) return -1;
+    p += written;
+    length -= (size_t)written;
+  }
+
+  return 0;
+}
+
+int factor_cache_store(const char* cache_dir, FactorCacheKey key, const CholeskyMatrix* matrix,
+                       size_t max_bytes) {
+  char path[4096], tmp_path[4096 + 32];
+  FactorCacheHeader header;
+  int fd, failed;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, FACTOR_CACHE_MAGIC, sizeof(header.magic));
+  header.layout_version = FACTOR_CACHE_LAYOUT_VERSION;
+  header.size = matrix->size;
+  header.block_size = matrix->block_size;
+  header.pivoting = matrix->pivots != NULL;
+  header.key = key.key;
+  header.digest = key.digest;
+
+  get_entry_path(cache_dir, key.key, path, sizeof(path));
+  snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+
+  fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return -1;
+
+  failed = write_all(fd, &header, sizeof(header)) ||
+           write_all(fd, matrix->data,
+                     get_symmetric_matrix_size(matrix->size) * sizeof(double)) ||
+           write_all(fd, matrix->diagonal, (size_t)matrix->size * sizeof(double)) ||
+           (matrix->pivots &&
+            write_all(fd, matrix->pivots, (size_t)matrix->size * sizeof(int32_t)));
+  failed = close(fd) || failed;
+
+  // Publish atomically so that concurrent readers never map a half-written factor.
+  if (failed || rename(tmp_path, path) != 0) {
+    unlink(tmp_path);
+    return -2;
+  }
+
+  evict_entries(cache_dir, path, max_bytes);
+  return 0;
+}
+
+void factor_cache_release(FactorCacheMapping* mapping) {
+  if (mapping->base) munmap(mapping->base, mapping->length);
+  mapping->base = NULL;
+  mapping->length = 0;
+}
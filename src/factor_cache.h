@@ -0,0 +1,74 @@
+#ifndef FACTOR_CACHE_H
+#define FACTOR_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matrix_utils.h"
+
+// Bumped whenever the on-disk factor layout changes; stale files are treated as misses.
+#define FACTOR_CACHE_LAYOUT_VERSION 3
+
+// A factor mapped from the cache directory; the matrix arrays point into it.
+typedef struct {
+  void* base;     // Start of the mapped file (NULL when nothing is mapped).
+  size_t length;  // Length of the mapping in bytes.
+} FactorCacheMapping;
+
+// Identifies a packed input. The key names the cache entry; the digest is an
+// independent hash stored in the entry and compared on load, so a hit needs
+// both 64-bit hashes to match.
+typedef struct {
+  uint64_t key;
+  uint64_t digest;
+} FactorCacheKey;
+
+// Hashes the packed input matrix together with its size, block size and
+// decomposition kind (pivoted or not).
+//
+// Args:
+//   matrix: Matrix holding the packed input (before decomposition).
+//
+// Returns:
+//   Key and digest identifying the input byte for byte.
+FactorCacheKey factor_cache_key(const CholeskyMatrix* matrix);
+
+// Maps a previously stored factor for the given key.
+//
+// On a hit matrix->data, matrix->diagonal and (when the matrix has pivots)
+// matrix->pivots are redirected into a private copy-on-write mapping and
+// matrix->mapped is set; the caller must not free or realloc() them and must
+// release the mapping with factor_cache_release() instead.
+//
+// Args:
+//   cache_dir: Directory holding the cached factors.
+//   key: Key of the input returned by factor_cache_key(); an entry whose
+//     digest differs is a miss.
+//   matrix: Matrix whose size and block size must match the stored factor.
+//   mapping: Output mapping descriptor.
+//
+// Returns:
+//   0 on a hit, 1 on a miss.
+int factor_cache_load(const char* cache_dir, FactorCacheKey key, CholeskyMatrix* matrix,
+                      FactorCacheMapping* mapping);
+
+// Stores a computed factor and evicts least recently used entries above the size cap.
+//
+// Args:
+//   cache_dir: Directory holding the cached factors (must exist).
+//   key: Key returned by factor_cache_key() for the original input.
+//   matrix: Decomposed matrix (factor, D and pivots if any).
+//   max_bytes: Upper bound on the total size of the cache directory.
+//
+// Returns:
+//   0 on success, non-zero if the factor could not be written.
+int factor_cache_store(const char* cache_dir, FactorCacheKey key, const CholeskyMatrix* matrix,
+                       size_t max_bytes);
+
+// Unmaps a factor obtained from factor_cache_load().
+//
+// Args:
+//   mapping: Mapping descriptor (no-op when nothing is mapped).
+void factor_cache_release(FactorCacheMapping* mapping);
+
+#endif
@@ -0,0 +1,178 @@
+#include "inverse_op.h"
+
+#include <string.h>
+
+#include "array_kernels.h"
+#include "matrix_utils.h"
+
+// Scratch blocks of the inverse routines (each block_size^2 doubles), followed
+// by block_size ones used as the D of unscaled products.
+enum {
+  INVERSE_DIAGONAL_INVERSE,  // R_ii^{-1}.
+  INVERSE_DIAGONAL_INVERSE_T,
+  INVERSE_LEFT,    // Transposed left operand.
+  INVERSE_RIGHT,   // Right operand (transposed in the second pass).
+  INVERSE_TILE,    // Tile being accumulated.
+  INVERSE_OUTPUT,  // Scaled tile / staging.
+  INVERSE_SCRATCH_BLOCKS
+};
+
+size_t get_inverse_workspace_size(int block_size) {
+  return INVERSE_SCRATCH_BLOCKS * (size_t)block_size * block_size + block_size;
+}
+
+// Copies the block (row, column) of size n x m from the packed matrix into b
+// transposed (m x n). A diagonal block (row == column) is read from its upper
+// triangle only, and its transpose is zero above the diagonal.
+static void cpy_matrix_block_to_transposed_block(const double* a, int row, int column,
+                                                 int matrix_size, int n, int m, double* b) {
+  int i, j;
+
+  if (row == column) memset(b, 0, (size_t)n * m * sizeof(double));
+
+  for (i = 0; i < n; ++i) {
+    int first = (row == column ? i : 0);
+    const double* pa = a + get_symmetric_index(row + i, column + first, matrix_size);
+
+    for (j = first; j < m; ++j) b[(size_t)j * n + i] = pa[j - first];
+  }
+}
+
+// Replaces the packed factor R by W = R^{-1}, one block row at a time from the
+// bottom: W_ij = -R_ii^{-1} sum_{i < k <= j} R_ik W_kj.
+static int invert_upper_factor(int n, int block_size, double* data, double* workspace) {
+  size_t block_elements = (size_t)block_size * block_size;
+  double* diagonal_inverse = workspace + INVERSE_DIAGONAL_INVERSE * block_elements;
+  double* diagonal_inverse_t = workspace + INVERSE_DIAGONAL_INVERSE_T * block_elements;
+  double* left = workspace + INVERSE_LEFT * block_elements;
+  double* right = workspace + INVERSE_RIGHT * block_elements;
+  double* tile = workspace + INVERSE_TILE * block_elements;
+  double* output = workspace + INVERSE_OUTPUT * block_elements;
+  double* ones = workspace + INVERSE_SCRATCH_BLOCKS * block_elements;
+  int block_count = (n + block_size - 1) / block_size;
+  int bi, bj, bk, r, c;
+
+  for (r = 0; r < block_size; ++r) ones[r] = 1.0;
+
+  for (bi = block_count - 1; bi >= 0; --bi) {
+    int i = bi * block_size;
+    int rows = (i + block_size < n ? block_size : n - i);
+
+    cpy_diagonal_block_to_block(data, i, n, rows, output);
+    if (inverse_upper_triangle_block_and_diagonal(rows, output, ones, diagonal_inverse)) return -1;
+    for (r = 0; r < rows; ++r) {
+      for (c = 0; c < rows; ++c) diagonal_inverse_t[c * rows + r] = diagonal_inverse[r * rows + c];
+    }
+
+    // Right to left, so that R_ik (k <= j) is still in place when W_ij is computed.
+    for (bj = block_count - 1; bj > bi; --bj) {
+      int j = bj * block_size;
+      int columns = (j + block_size < n ? block_size : n - j);
+
+      memset(tile, 0, (size_t)rows * columns * sizeof(double));
+      for (bk = bi + 1; bk <= bj; ++bk) {
+        int k = bk * block_size;
+        int k_rows = (k + block_size < n ? block_size : n - k);
+
+        cpy_matrix_block_to_transposed_block(data, i, k, n, rows, k_rows, left);
+        if (bk == bj)
+          cpy_diagonal_block_to_block(data, k, n, k_rows, right);
+        else
+          cpy_matrix_block_to_block(data, k, j, n, k_rows, columns, right);
+
+        // tile -= R_ik W_kj.
+        main_blocks_diagonal_multiply(k_rows, rows, columns, left, right, ones, tile, NULL);
+      }
+
+      main_blocks_multiply(rows, rows, columns, diagonal_inverse_t, tile, output);
+      cpy_block_to_matrix_block(data, i, j, n, rows, columns, output);
+    }
+
+    cpy_block_to_diagonal_block(data, i, n, rows, diagonal_inverse);
+  }
+
+  return 0;
+}
+
+int cholesky_selected_inverse(const CholeskyMatrix* factor, const unsigned char* selected_blocks,
+                              double* inverse, double* workspace) {
+  int n = factor->size;
+  int block_size = factor->block_size;
+  int block_count = (n + block_size - 1) / block_size;
+  size_t block_elements = (size_t)block_size * block_size;
+  double* left = workspace + INVERSE_LEFT * block_elements;
+  double* right = workspace + INVERSE_RIGHT * block_elements;
+  double* tile = workspace + INVERSE_TILE * block_elements;
+  int bi, bj, bk, t;
+
+  if (inverse == factor->data) return -2;
+
+  memcpy(inverse, factor->data, get_symmetric_matrix_size(n) * sizeof(double));
+  if (invert_upper_factor(n, block_size, inverse, workspace)) return -1;
+
+  // Top-down: tile (i, j) reads W_ik and W_jk for k >= j only, which no
+  // earlier tile has overwritten.
+  for (bi = 0; bi < block_count; ++bi) {
+    int i = bi * block_size;
+    int rows = (i + block_size < n ? block_size : n - i);
+
+    for (bj = bi; bj < block_count; ++bj) {
+      int j = bj * block_size;
+      int columns = (j + block_size < n ? block_size : n - j);
+
+      if (selected_blocks && !selected_blocks[(size_t)bi * block_count + bj]) continue;
+
+      memset(tile, 0, (size_t)rows * columns * sizeof(double));
+      for (bk = bj; bk < block_count; ++bk) {
+        int k = bk * block_size;
+        int k_rows = (k + block_size < n ? block_size : n - k);
+
+        cpy_matrix_block_to_transposed_block(inverse, i, k, n, rows, k_rows, left);
+        cpy_matrix_block_to_transposed_block(inverse, j, k, n, columns, k_rows, right);
+
+        // tile -= W_ik D_k W_jk^T.
+        main_blocks_diagonal_multiply(k_rows, rows, columns, left, right, factor->diagonal + k,
+                                      tile, NULL);
+      }
+
+      for (t = 0; t < rows * columns; ++t) tile[t] = -tile[t];
+
+      if (bj != bi)
+        cpy_block_to_matrix_block(inverse, i, j, n, rows, columns, tile);
+      else
+        cpy_block_to_diagonal_block(inverse, i, n, rows, tile);
+    }
+  }
+
+  return 0;
+}
+
+int cholesky_inverse_diagonal(const CholeskyMatrix* factor, double* inverse, double* diagonal,
+                              double* workspace) {
+  int n = factor->size;
+  const double* row;
+  int i, k;
+
+  if (inverse == factor->data) return -2;
+
+  memcpy(inverse, factor->data, get_symmetric_matrix_size(n) * sizeof(double));
+  if (invert_upper_factor(n, factor->block_size, inverse, workspace)) return -1;
+
+  // Packed row i of W is W(i, i:n).
+  row = inverse;
+  for (i = 0; i < n; ++i) {
+    const double* d = factor->diagonal + i;
+    double s0 = 0, s1 = 0;
+
+    for (k = 0; k < n - i - 1; k += 2) {
+      s0 += d[k] * row[k] * row[k];
+      s1 += d[k + 1] * row[k + 1] * row[k + 1];
+    }
+    for (; k < n - i; ++k) s0 += d[k] * row[k] * row[k];
+
+    diagonal[i] = s0 + s1;
+    row += n - i;
+  }
+
+  return 0;
+}
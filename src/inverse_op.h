@@ -0,0 +1,53 @@
+#ifndef INVERSE_OP_H
+#define INVERSE_OP_H
+
+#include <stddef.h>
+
+#include "matrix_utils.h"
+
+// Returns the number of doubles of workspace required by the inverse routines.
+//
+// Args:
+//   block_size: Block size of the matrix.
+size_t get_inverse_workspace_size(int block_size);
+
+// Computes selected blocks of A^{-1} from the factor A = R^T D R.
+//
+// With W = R^{-1} (a blocked triangular inversion in place, O(N^3 / 6)),
+// A^{-1} = W D W^T, so the tile (I, J), I <= J, is sum_{K >= J} W_IK D_K W_JK^T.
+// Block rows are processed top-down and each tile only reads W tiles to its
+// right, so the inverse overwrites W in the same packed storage. The factor
+// itself is only read.
+//
+// Args:
+//   factor: Decomposed matrix (cholesky() mode).
+//   selected_blocks: block_count x block_count flags, row-major, of the tiles
+//     (I, J), I <= J, to compute; NULL computes the whole inverse. Tiles that
+//     are not selected are left holding W.
+//   inverse: get_symmetric_matrix_size(size) doubles of caller storage
+//     receiving the packed result; must not overlap factor->data.
+//   workspace: get_inverse_workspace_size() doubles.
+//
+// Returns:
+//   0 on success, -1 if R is singular, -2 if inverse is factor->data.
+int cholesky_selected_inverse(const CholeskyMatrix* factor, const unsigned char* selected_blocks,
+                              double* inverse, double* workspace);
+
+// Computes diag(A^{-1}) from the factor A = R^T D R.
+//
+// (A^{-1})_ii = sum_{k >= i} d_k W_ik^2 is read off the packed rows of W = R^{-1},
+// so only the triangular inversion is needed. The factor itself is only read.
+//
+// Args:
+//   factor: Decomposed matrix (cholesky() mode).
+//   inverse: get_symmetric_matrix_size(size) doubles of caller storage that
+//     receive W; must not overlap factor->data.
+//   diagonal: Output vector of size doubles.
+//   workspace: get_inverse_workspace_size() doubles.
+//
+// Returns:
+//   0 on success, -1 if R is singular, -2 if inverse is factor->data.
+int cholesky_inverse_diagonal(const CholeskyMatrix* factor, double* inverse, double* diagonal,
+                              double* workspace);
+
+#endif
@@ -0,0 +1,336 @@
+#include "ldlt_op.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_kernels.h"
+#include "matrix_utils.h"
+
+// Bunch-Kaufman threshold (1 + sqrt(17)) / 8, which minimizes element growth.
+static const double BUNCH_KAUFMAN_ALPHA = 0.64038820320220756872767623199676;
+
+// Returns a pointer to the element (i, j), i >= j, of the lower triangle.
+// Column j of the lower triangle is row j of the packed upper triangle.
+static inline double* lower_element(double* data, int i, int j, int n) {
+  return data + get_symmetric_index(j, i, n);
+}
+
+static inline void swap_doubles(double* a, double* b) {
+  double t = *a;
+  *a = *b;
+  *b = t;
+}
+
+// Returns the panel width used by ldlt(); a 2x2 pivot needs at least two columns.
+static int get_panel_width(int block_size) {
+  return block_size < 2 ? 2 : block_size;
+}
+
+size_t get_ldlt_workspace_size(int matrix_size, int block_size) {
+  size_t panel_width = get_panel_width(block_size);
+  return panel_width * matrix_size + 2 * panel_width * block_size +
+         (size_t)block_size * block_size + panel_width;
+}
+
+// Applies the delayed updates of the panel columns [k0, k) to a column:
+// column[i] -= sum_p L(i, p) * W(w_row, p) for i in [k, n).
+static void update_panel_column(const double* data, int n, int k0, int k, const double* w,
+                                int w_row, double* column) {
+  int p, i;
+
+  for (p = k0; p < k; ++p) {
+    double f = w[(size_t)(p - k0) * n + w_row];
+    const double* lp = data + get_symmetric_index(p, k, n) - k;
+
+    for (i = k; i < n - 7; i += 8) {
+      column[i] -= lp[i] * f;
+      column[i + 1] -= lp[i + 1] * f;
+      column[i + 2] -= lp[i + 2] * f;
+      column[i + 3] -= lp[i + 3] * f;
+      column[i + 4] -= lp[i + 4] * f;
+      column[i + 5] -= lp[i + 5] * f;
+      column[i + 6] -= lp[i + 6] * f;
+      column[i + 7] -= lp[i + 7] * f;
+    }
+
+    for (; i < n; ++i) {
+      column[i] -= lp[i] * f;
+    }
+  }
+}
+
+// Factorizes up to panel_width - 1 columns starting at k0 with delayed updates
+// (all remaining columns if they fit into the panel), leaving W = L D for the
+// factorized columns in w. Mirrors LAPACK's dlasyf for the lower triangle.
+//
+// Returns the first column not factorized, or -1 if the matrix is singular.
+static int factorize_panel(double* data, int n, int k0, int panel_width, double* w,
+                           int* pivots) {
+  int k = k0, i, j, p;
+
+  while (1) {
+    int kw = k - k0, kstep = 1, kp, kk, imax = k;
+    double* wk = w + (size_t)kw * n;
+    double absakk, colmax = 0.0;
+
+    if ((kw >= panel_width - 1 && panel_width < n - k0) || k >= n) break;
+
+    // Copy column k of A to column kw of W and apply the delayed updates.
+    memcpy(wk + k, lower_element(data, k, k, n), (n - k) * sizeof(double));
+    update_panel_column(data, n, k0, k, w, k, wk);
+
+    absakk = fabs(wk[k]);
+    for (i = k + 1; i < n; ++i) {
+      if (fabs(wk[i]) > colmax) {
+        colmax = fabs(wk[i]);
+        imax = i;
+      }
+    }
+
+    if ((absakk > colmax ? absakk : colmax) < EPS) return -1;
+
+    if (absakk >= BUNCH_KAUFMAN_ALPHA * colmax) {
+      kp = k;
+    } else {
+      double* wk1 = wk + n;
+      double rowmax = 0.0;
+
+      // Copy column imax to column kw + 1 of W and apply the delayed updates.
+      for (i = k; i < imax; ++i) wk1[i] = *lower_element(data, imax, i, n);
+      memcpy(wk1 + imax, lower_element(data, imax, imax, n), (n - imax) * sizeof(double));
+      update_panel_column(data, n, k0, k, w, imax, wk1);
+
+      for (i = k; i < n; ++i) {
+        if (i != imax && fabs(wk1[i]) > rowmax) rowmax = fabs(wk1[i]);
+      }
+
+      if (absakk >= BUNCH_KAUFMAN_ALPHA * colmax * (colmax / rowmax)) {
+        kp = k;
+      } else if (fabs(wk1[imax]) >= BUNCH_KAUFMAN_ALPHA * rowmax) {
+        kp = imax;
+        memcpy(wk + k, wk1 + k, (n - k) * sizeof(double));
+      } else {
+        kp = imax;
+        kstep = 2;
+      }
+    }
+
+    kk = k + kstep - 1;
+
+    // The updated column kp is already in column kk of W; move the
+    // non-updated column kk of A into column kp and swap rows kk and kp of
+    // the panel columns of A and W.
+    if (kp != kk) {
+      *lower_element(data, kp, kp, n) = *lower_element(data, kk, kk, n);
+      for (j = kk + 1; j < kp; ++j) *lower_element(data, kp, j, n) = *lower_element(data, j, kk, n);
+      for (i = kp + 1; i < n; ++i) *lower_element(data, i, kp, n) = *lower_element(data, i, kk, n);
+
+      for (p = k0; p < kk; ++p)
+        swap_doubles(lower_element(data, kk, p, n), lower_element(data, kp, p, n));
+      for (p = 0; p <= kk - k0; ++p) swap_doubles(w + (size_t)p * n + kk, w + (size_t)p * n + kp);
+    }
+
+    if (kstep == 1) {
+      double* lk = lower_element(data, k, k, n);
+      double r1;
+
+      memcpy(lk, wk + k, (n - k) * sizeof(double));
+      r1 = 1.0 / lk[0];
+      for (i = 1; i < n - k; ++i) lk[i] *= r1;
+
+      pivots[k] = kp;
+    } else {
+      double* wk1 = wk + n;
+
+      if (k < n - 2) {
+        double d21 = wk[k + 1];
+        double d11 = wk1[k + 1] / d21;
+        double d22 = wk[k] / d21;
+        double t = 1.0 / (d11 * d22 - 1.0);
+        double* lk = lower_element(data, k, k, n) - k;
+        double* lk1 = lower_element(data, k + 1, k + 1, n) - (k + 1);
+
+        d21 = t / d21;
+        for (j = k + 2; j < n; ++j) {
+          lk[j] = d21 * (d11 * wk[j] - wk1[j]);
+          lk1[j] = d21 * (d22 * wk1[j] - wk[j]);
+        }
+      }
+
+      *lower_element(data, k, k, n) = wk[k];
+      *lower_element(data, k + 1, k, n) = wk[k + 1];
+      *lower_element(data, k + 1, k + 1, n) = wk1[k + 1];
+
+      pivots[k] = pivots[k + 1] = -(kp + 1);
+    }
+
+    k += kstep;
+  }
+
+  return k;
+}
+
+// Applies A22 = A22 - L21 W21^T to the trailing matrix [k, n) with the block
+// kernel, for the panel columns [k0, k).
+static void update_trailing_matrix(double* data, int n, int block_size, int k0, int k,
+                                   const double* w, double* workspace, int panel_width) {
+  int panel_columns = k - k0;
+  double* ma = workspace;
+  double* mb = ma + (size_t)panel_width * block_size;
+  double* mc = mb + (size_t)panel_width * block_size;
+  double* ones = mc + (size_t)block_size * block_size;
+  int r, c, p;
+
+  for (p = 0; p < panel_columns; ++p) ones[p] = 1.0;
+
+  for (r = k; r < n; r += block_size) {
+    int rows = (r + block_size < n ? block_size : n - r);
+
+    // A = W(r-tile, panel)^T, one panel column per row of the buffer.
+    for (p = 0; p < panel_columns; ++p)
+      memcpy(ma + (size_t)p * rows, w + (size_t)p * n + r, rows * sizeof(double));
+
+    for (c = r; c < n; c += block_size) {
+      int columns = (c + block_size < n ? block_size : n - c);
+
+      // B = L(c-tile, panel)^T, i.e. rows k0..k-1 of the packed upper triangle.
+      cpy_matrix_block_to_block(data, k0, c, n, panel_columns, columns, mb);
+
+      if (c != r)
+        cpy_matrix_block_to_block(data, r, c, n, rows, columns, mc);
+      else
+        cpy_diagonal_block_to_block(data, r, n, rows, mc);
+
+      main_blocks_diagonal_multiply(panel_columns, rows, columns, ma, mb, ones, mc, NULL);
+
+      if (c != r)
+        cpy_block_to_matrix_block(data, r, c, n, rows, columns, mc);
+      else
+        cpy_block_to_diagonal_block(data, r, n, rows, mc);
+    }
+  }
+}
+
+// Puts the panel columns of L back into the interleaved form expected by the
+// solve by undoing the row interchanges applied to earlier panel columns.
+static void restore_panel_interchanges(double* data, int n, int k0, int k, const int* pivots) {
+  int j = k - 1, p;
+
+  while (j >= k0) {
+    int jj = j;
+    int jp = pivots[j];
+
+    if (jp < 0) {
+      jp = -jp - 1;
+      j--;
+    }
+    j--;
+
+    if (jp != jj && j >= k0) {
+      for (p = k0; p <= j; ++p)
+        swap_doubles(lower_element(data, jp, p, n), lower_element(data, jj, p, n));
+    }
+  }
+}
+
+int ldlt(CholeskyMatrix* matrix, double* workspace) {
+  int n = matrix->size;
+  int block_size = matrix->block_size;
+  int panel_width = get_panel_width(block_size);
+  double* data = matrix->data;
+  double* w = workspace;
+  double* tile_workspace = w + (size_t)panel_width * n;
+  int k0 = 0, k, i;
+
+  while (k0 < n) {
+    k = factorize_panel(data, n, k0, panel_width, w, matrix->pivots);
+    if (k < 0) return -1;
+
+    update_trailing_matrix(data, n, block_size, k0, k, w, tile_workspace, panel_width);
+    restore_panel_interchanges(data, n, k0, k, matrix->pivots);
+
+    k0 = k;
+  }
+
+  for (i = 0; i < n; ++i) matrix->diagonal[i] = data[get_symmetric_index(i, i, n)];
+
+  return 0;
+}
+
+int solve_ldlt_system(const CholeskyMatrix* matrix, double* rhs) {
+  int n = matrix->size;
+  const double* data = matrix->data;
+  const int* pivots = matrix->pivots;
+  int k, i;
+
+  // Solve L D y = P b.
+  k = 0;
+  while (k < n) {
+    const double* lk = data + get_symmetric_index(k, k, n) - k;
+
+    if (pivots[k] >= 0) {
+      int kp = pivots[k];
+      double bk;
+
+      if (kp != k) swap_doubles(rhs + k, rhs + kp);
+
+      bk = rhs[k];
+      for (i = k + 1; i < n; ++i) rhs[i] -= lk[i] * bk;
+
+      if (fabs(lk[k]) < EPS) return -1;
+      rhs[k] /= lk[k];
+      k += 1;
+    } else {
+      const double* lk1 = data + get_symmetric_index(k + 1, k + 1, n) - (k + 1);
+      int kp = -pivots[k] - 1;
+      double akm1k, akm1, ak, denom, bkm1, bk;
+
+      if (kp != k + 1) swap_doubles(rhs + k + 1, rhs + kp);
+
+      bkm1 = rhs[k];
+      bk = rhs[k + 1];
+      for (i = k + 2; i < n; ++i) rhs[i] -= lk[i] * bkm1 + lk1[i] * bk;
+
+      akm1k = lk[k + 1];
+      akm1 = lk[k] / akm1k;
+      ak = lk1[k + 1] / akm1k;
+      denom = akm1 * ak - 1.0;
+      if (fabs(denom) < EPS) return -1;
+
+      bkm1 = rhs[k] / akm1k;
+      bk = rhs[k + 1] / akm1k;
+      rhs[k] = (ak * bkm1 - bk) / denom;
+      rhs[k + 1] = (akm1 * bk - bkm1) / denom;
+      k += 2;
+    }
+  }
+
+  // Solve L^T P x = y.
+  k = n - 1;
+  while (k >= 0) {
+    const double* lk = data + get_symmetric_index(k, k, n) - k;
+    double sum = 0.0;
+
+    for (i = k + 1; i < n; ++i) sum += lk[i] * rhs[i];
+    rhs[k] -= sum;
+
+    if (pivots[k] >= 0) {
+      if (pivots[k] != k) swap_doubles(rhs + k, rhs + pivots[k]);
+      k -= 1;
+    } else {
+      const double* lkm1 = data + get_symmetric_index(k - 1, k - 1, n) - (k - 1);
+      int kp = -pivots[k] - 1;
+
+      sum = 0.0;
+      for (i = k + 1; i < n; ++i) sum += lkm1[i] * rhs[i];
+      rhs[k - 1] -= sum;
+
+      if (kp != k) swap_doubles(rhs + k, rhs + kp);
+      k -= 2;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef LDLT_OP_H
+#define LDLT_OP_H
+
+#include <stddef.h>
+
+#include "matrix_utils.h"
+
+// Returns the number of doubles of workspace required by ldlt().
+//
+// Args:
+//   matrix_size: Dimension of the matrix.
+//   block_size: Block size of the matrix (panel width of the factorization).
+size_t get_ldlt_workspace_size(int matrix_size, int block_size);
+
+// Performs the blocked symmetric indefinite decomposition P A P^T = L D L^T
+// with Bunch-Kaufman pivoting.
+//
+// D is block diagonal with 1x1 and 2x2 blocks. The factor is left in the packed
+// storage in the LAPACK packed-lower layout (row i of the packed upper triangle
+// is column i of L): the diagonal holds D, the slot (k, k + 1) holds the
+// off-diagonal entry of a 2x2 block starting at k and the remaining entries
+// hold L without its unit diagonal. matrix->diagonal receives the diagonal of D
+// and matrix->pivots the interchanges: pivots[k] = p >= 0 for a 1x1 block with
+// rows k and p swapped, pivots[k] = pivots[k + 1] = -(p + 1) for a 2x2 block
+// with rows k + 1 and p swapped.
+//
+// Args:
+//   matrix: Pointer to the CholeskyMatrix structure (pivots must be allocated).
+//   workspace: Pre-allocated memory (get_ldlt_workspace_size() doubles).
+//
+// Returns:
+//   0 on success, -1 if the matrix is singular.
+int ldlt(CholeskyMatrix* matrix, double* workspace);
+
+// Solves A x = b using the decomposition computed by ldlt().
+//
+// Args:
+//   matrix: Decomposed matrix structure (including D and pivots).
+//   rhs: The right-hand side vector (modified in-place to solution x).
+//
+// Returns:
+//   0 on success, non-zero on error.
+int solve_ldlt_system(const CholeskyMatrix* matrix, double* rhs);
+
+#endif
@@ -1,37 +1,263 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "matrix_generators.h"
+#include "solver_daemon.h"
 #include "solver_engine.h"
 #include "timer.h"
 
+static void print_usage(void) {
+  printf("Usage: ./cholesky_solver [options] (matrix_size) (block_size) [matrix_input_file]\n");
+  printf("Options:\n");
+  printf("  --cache-dir=DIR      Reuse factors of identical inputs stored in DIR\n");
+  printf("  --cache-max-mb=N     Size cap of the factor cache in MiB (default 1024)\n");
+  printf("  --mode=MODE          Decomposition: cholesky (default) or ldlt (indefinite)\n");
+  printf("  --threads=N          Threads of the Cholesky decomposition and generator (default 1)\n");
+  printf("  --reduction=ORDER    Parallel reduction: ordered (default, reproducible) or unordered\n");
+  printf("  --generator=NAME     Test matrix family when no input file is given:\n");
+  for (int i = 0; i < matrix_generator_count; ++i)
+    printf("                         %-11s %s\n", matrix_generators[i].name,
+           matrix_generators[i].description);
+  printf("  --seed=N             Seed of the randomized matrix families (default 0)\n");
+  printf("  --split-at=K         Factor the first K rows, then resume from the Schur complement\n");
+  printf("  --extend=P           Factor all but the last P rows, then append them incrementally\n");
+  printf("  --tlr=TOL            Compress off-diagonal factor tiles to low rank, tolerance TOL\n");
+  printf("  --inverse=PART       Compute diagonal or full A^-1 from the factor and check it\n");
+  printf("  --print-hashes       Print hashes of the factor, D and the solution\n");
+  printf("  --stage-times        Also print every stage time in nanoseconds (Stage: lines)\n");
+  printf("  --profile            Print the pack/update/factor split of the decomposition\n");
+  printf("  --daemon=SOCKET      Serve factor/solve requests on a Unix-domain socket\n");
+  printf("  --batch-max=N        Most right-hand sides coalesced into one solve (default 64)\n");
+  printf("  --batch-window-us=N  Time to wait for more solves before batching (default 0)\n");
+}
+
+// Returns the value of an argument of the form "--name=value", or NULL if it does not match.
+static const char* get_option_value(const char* arg, const char* name) {
+  size_t name_length = strlen(name);
+
+  if (strncmp(arg, name, name_length) != 0 || arg[name_length] != '=') return NULL;
+  return arg + name_length + 1;
+}
+
 int main(int argc, char* argv[]) {
-  SolverConfig config = {0, 0, NULL};
+  SolverConfig config = {0, 0, NULL, NULL, (size_t)1024 << 20, SOLVER_MODE_CHOLESKY, 1,
+                         REDUCTION_ORDERED, 0, NULL, 0, 0, 0, 0, INVERSE_MODE_NONE, 0};
   SolverResults results = {0, 0, 0, NULL, 0};
+  DaemonConfig daemon_config = {NULL, 64, 0};
+  const char* positional[3];
+  int positional_count = 0;
   int return_code = 0;
 
   timer_start();
 
   /* 1. Argument Parsing */
-  if (argc == 3 || argc == 4) {
+  for (int i = 1; i < argc; ++i) {
+    const char* value;
+    char* endptr;
+
+    if (strncmp(argv[i], "--", 2) != 0) {
+      if (positional_count == 3) {
+        print_usage();
+        return 0;
+      }
+      positional[positional_count++] = argv[i];
+    } else if ((value = get_option_value(argv[i], "--cache-dir")) != NULL) {
+      config.cache_dir = value;
+    } else if ((value = get_option_value(argv[i], "--cache-max-mb")) != NULL) {
+      long megabytes = strtol(value, &endptr, 10);
+      if (*endptr != '\0' || megabytes <= 0) {
+        printf("Error: invalid cache size '%s'\n", value);
+        return -1;
+      }
+      config.cache_max_bytes = (size_t)megabytes << 20;
+    } else if ((value = get_option_value(argv[i], "--mode")) != NULL) {
+      if (strcmp(value, "cholesky") == 0) {
+        config.mode = SOLVER_MODE_CHOLESKY;
+      } else if (strcmp(value, "ldlt") == 0) {
+        config.mode = SOLVER_MODE_LDLT;
+      } else {
+        printf("Error: unknown mode '%s'\n", value);
+        return -1;
+      }
+    } else if ((value = get_option_value(argv[i], "--threads")) != NULL) {
+      config.thread_count = (int)strtol(value, &endptr, 10);
+      if (*endptr != '\0' || config.thread_count <= 0) {
+        printf("Error: invalid thread count '%s'\n", value);
+        return -1;
+      }
+    } else if ((value = get_option_value(argv[i], "--reduction")) != NULL) {
+      if (strcmp(value, "ordered") == 0) {
+        config.reduction = REDUCTION_ORDERED;
+      } else if (strcmp(value, "unordered") == 0) {
+        config.reduction = REDUCTION_UNORDERED;
+      } else {
+        printf("Error: unknown reduction '%s'\n", value);
+        return -1;
+      }
+    } else if ((value = get_option_value(argv[i], "--generator")) != NULL) {
+      config.generator = find_matrix_generator(value);
+      if (config.generator == NULL) {
+        printf("Error: unknown generator '%s'\n", value);
+        return -1;
+      }
+    } else if ((value = get_option_value(argv[i], "--seed")) != NULL) {
+      config.seed = strtoull(value, &endptr, 10);
+      if (*endptr != '\0' || *value == '\0') {
+        printf("Error: invalid seed '%s'\n", value);
+        return -1;
+      }
+    } else if ((value = get_option_value(argv[i], "--split-at")) != NULL) {
+      config.split_row = (int)strtol(value, &endptr, 10);
+      if (*endptr != '\0' || config.split_row <= 0) {
+        printf("Error: invalid split row '%s'\n", value);
+        return -1;
+      }
+    } else if ((value = get_option_value(argv[i], "--extend")) != NULL) {
+      config.extend_count = (int)strtol(value, &endptr, 10);
+      if (*endptr != '\0' || config.extend_count <= 0) {
+        printf("Error: invalid extension row count '%s'\n", value);
+        return -1;
+      }
+    } else if ((value = get_option_value(argv[i], "--tlr")) != NULL) {
+      config.tlr_tolerance = strtod(value, &endptr);
+      if (*endptr != '\0' || !(config.tlr_tolerance > 0 && config.tlr_tolerance < 1)) {
+        printf("Error: invalid TLR tolerance '%s'\n", value);
+        return -1;
+      }
+    } else if ((value = get_option_value(argv[i], "--inverse")) != NULL) {
+      if (strcmp(value, "diagonal") == 0) {
+        config.inverse_mode = INVERSE_MODE_DIAGONAL;
+      } else if (strcmp(value, "full") == 0) {
+        config.inverse_mode = INVERSE_MODE_FULL;
+      } else {
+        printf("Error: unknown inverse part '%s'\n", value);
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--print-hashes") == 0) {
+      config.print_hashes = 1;
+    } else if (strcmp(argv[i], "--profile") == 0) {
+      config.profile = 1;
+    } else if (strcmp(argv[i], "--stage-times") == 0) {
+      timer_print_stages(1);
+    } else if ((value = get_option_value(argv[i], "--daemon")) != NULL) {
+      daemon_config.socket_path = value;
+    } else if ((value = get_option_value(argv[i], "--batch-max")) != NULL) {
+      daemon_config.max_batch = (int)strtol(value, &endptr, 10);
+      if (*endptr != '\0' || daemon_config.max_batch <= 0) {
+        printf("Error: invalid batch size '%s'\n", value);
+        return -1;
+      }
+    } else if ((value = get_option_value(argv[i], "--batch-window-us")) != NULL) {
+      daemon_config.batch_window_us = (int)strtol(value, &endptr, 10);
+      if (*endptr != '\0' || daemon_config.batch_window_us < 0) {
+        printf("Error: invalid batch window '%s'\n", value);
+        return -1;
+      }
+    } else {
+      printf("Error: unknown option '%s'\n", argv[i]);
+      return -1;
+    }
+  }
+
+  // The pivoted LDL^T decomposition only runs serially.
+  if (config.mode == SOLVER_MODE_LDLT && config.thread_count > 1) {
+    printf("Error: --mode=ldlt cannot be combined with --threads\n");
+    return -1;
+  }
+
+  // The reduction order only exists between threads.
+  if (config.reduction == REDUCTION_UNORDERED && config.thread_count == 1) {
+    printf("Error: --reduction=unordered requires --threads greater than 1\n");
+    return -1;
+  }
+
+  // The TLR factor is computed by the serial Cholesky path and lives outside the matrix.
+  if (config.tlr_tolerance > 0 &&
+      (config.mode != SOLVER_MODE_CHOLESKY || config.split_row || config.thread_count > 1 ||
+       config.cache_dir || config.print_hashes)) {
+    printf("Error: --tlr cannot be combined with --mode=ldlt, --split-at, --threads, "
+           "--cache-dir or --print-hashes\n");
+    return -1;
+  }
+
+  // The inverse is computed from an R^T D R factor held in the matrix.
+  if (config.inverse_mode != INVERSE_MODE_NONE &&
+      (config.mode != SOLVER_MODE_CHOLESKY || config.tlr_tolerance > 0)) {
+    printf("Error: --inverse cannot be combined with --mode=ldlt or --tlr\n");
+    return -1;
+  }
+
+  // The split is a serial Cholesky decomposition interrupted at the split row.
+  if (config.split_row && (config.mode != SOLVER_MODE_CHOLESKY || config.thread_count > 1)) {
+    printf("Error: --split-at cannot be combined with --mode=ldlt or --threads\n");
+    return -1;
+  }
+
+  if (config.extend_count &&
+      (config.mode != SOLVER_MODE_CHOLESKY || config.split_row || config.thread_count > 1 ||
+       config.tlr_tolerance > 0)) {
+    printf("Error: --extend cannot be combined with --mode=ldlt, --split-at, --threads or --tlr\n");
+    return -1;
+  }
+
+  // Only the plain serial Cholesky decomposition records a time split.
+  if (config.profile &&
+      (config.mode != SOLVER_MODE_CHOLESKY || config.thread_count > 1 || config.split_row ||
+       config.extend_count || config.tlr_tolerance > 0)) {
+    printf("Error: --profile cannot be combined with --mode=ldlt, --threads, --split-at, "
+           "--extend or --tlr\n");
+    return -1;
+  }
+
+  // The daemon factors every request with the serial Cholesky path and no cache.
+  if (daemon_config.socket_path &&
+      (positional_count || config.cache_dir || config.mode != SOLVER_MODE_CHOLESKY ||
+       config.thread_count > 1 || config.reduction != REDUCTION_ORDERED || config.generator ||
+       config.seed || config.split_row || config.extend_count || config.tlr_tolerance > 0 ||
+       config.inverse_mode != INVERSE_MODE_NONE || config.print_hashes || config.profile)) {
+    printf("Error: --daemon only accepts --batch-max and --batch-window-us (got --mode, --threads, "
+           "--reduction, --cache-dir or another solver option)\n");
+    return -1;
+  }
+
+  if (daemon_config.socket_path) {
+    return run_solver_daemon(&daemon_config);
+  }
+
+  if (positional_count == 2 || positional_count == 3) {
     char* endptr;
-    config.matrix_size = (int)strtol(argv[1], &endptr, 10);
+    config.matrix_size = (int)strtol(positional[0], &endptr, 10);
     if (*endptr != '\0' || config.matrix_size <= 0) {
-      printf("Error: invalid matrix size '%s'\n", argv[1]);
+      printf("Error: invalid matrix size '%s'\n", positional[0]);
       return -1;
     }
 
-    config.block_size = (int)strtol(argv[2], &endptr, 10);
+    config.block_size = (int)strtol(positional[1], &endptr, 10);
     if (*endptr != '\0' || config.block_size <= 0 || config.block_size > config.matrix_size) {
-      printf("Error: invalid block size '%s' (must be between 1 and %d)\n", argv[2],
+      printf("Error: invalid block size '%s' (must be between 1 and %d)\n", positional[1],
+             config.matrix_size);
+      return -1;
+    }
+
+    if (config.split_row &&
+        (config.split_row >= config.matrix_size || config.split_row % config.block_size != 0)) {
+      printf("Error: split row %d must be a multiple of the block size below %d\n",
+             config.split_row, config.matrix_size);
+      return -1;
+    }
+
+    if (config.extend_count >= config.matrix_size) {
+      printf("Error: extension row count %d must be below %d\n", config.extend_count,
              config.matrix_size);
       return -1;
     }
 
-    if (argc == 4) {
-      config.input_file = argv[3];
+    if (positional_count == 3) {
+      config.input_file = positional[2];
     }
   } else {
-    printf("Usage: ./cholesky_solver (matrix_size) (block_size) [matrix_input_file]\n");
+    print_usage();
     return 0;
   }
 
@@ -0,0 +1,228 @@
+#include "matrix_generators.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "matrix_utils.h"
+
+// Half bandwidth of the "banded" family.
+#define GENERATOR_BANDWIDTH 16
+
+// Kernel length scale (relative to n) and diagonal nugget of the "covariance" family.
+#define COVARIANCE_LENGTH_SCALE 0.2
+#define COVARIANCE_NUGGET 1e-2
+
+// Counter-based uniform value in [-1, 1) for the element (row, column), row <= column
+// (splitmix64 finalizer over the seeded element index).
+static inline double uniform_element(uint64_t seed, int row, int column) {
+  uint64_t z = seed + 0x9e3779b97f4a7c15ULL * (((uint64_t)row << 32) | (uint32_t)column);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z ^= z >> 31;
+  return (double)(z >> 11) * 0x1.0p-52 - 1.0;
+}
+
+// The element functions below take row <= column.
+
+static inline double abs_element(int n, uint64_t seed, int row, int column) {
+  (void)seed;
+  (void)row;
+  return fabs(n - column);
+}
+
+// Diagonally dominant: the off-diagonal entries of a row sum to less than n - 1.
+static inline double random_spd_element(int n, uint64_t seed, int row, int column) {
+  return row == column ? n : uniform_element(seed, row, column);
+}
+
+static inline double banded_element(int n, uint64_t seed, int row, int column) {
+  (void)n;
+  if (row == column) return 2 * GENERATOR_BANDWIDTH + 1;
+  return column - row <= GENERATOR_BANDWIDTH ? uniform_element(seed, row, column) : 0;
+}
+
+// 5-point Laplacian with Dirichlet boundary on a grid floor(sqrt(n)) points wide,
+// numbered row by row (the last grid row may be partial).
+static inline double laplacian_element(int n, uint64_t seed, int row, int column) {
+  int width = (int)sqrt((double)n);
+  (void)seed;
+
+  if (row == column) return 4;
+  if (column == row + 1 && column % width != 0) return -1;
+  if (column == row + width) return -1;
+  return 0;
+}
+
+// Diagonally dominant with diagonal entries of alternating sign, so D has both signs.
+static inline double indefinite_element(int n, uint64_t seed, int row, int column) {
+  if (row == column) return row % 2 ? -n : n;
+  return uniform_element(seed, row, column);
+}
+
+// Squared-exponential covariance of n equispaced points with a length scale of
+// COVARIANCE_LENGTH_SCALE * n, plus a nugget on the diagonal. Off-diagonal
+// blocks are numerically low rank (see tlr_op.h).
+static inline double covariance_element(int n, uint64_t seed, int row, int column) {
+  double distance = (column - row) / (COVARIANCE_LENGTH_SCALE * n);
+  (void)seed;
+
+  return exp(-0.5 * distance * distance) + (row == column ? COVARIANCE_NUGGET : 0);
+}
+
+// Generates a row from a symmetric element function; inlined into each family
+// so that the element function is not called through a pointer.
+static inline void fill_row_from_elements(int n, uint64_t seed, int row, double* lower,
+                                          double* upper,
+                                          double (*element)(int, uint64_t, int, int)) {
+  int j;
+
+  for (j = 0; j < row; ++j) lower[j] = element(n, seed, j, row);
+  for (j = row; j < n; ++j) upper[j - row] = element(n, seed, row, j);
+}
+
+static void fill_abs_row(int n, uint64_t seed, int row, double* lower, double* upper) {
+  fill_row_from_elements(n, seed, row, lower, upper, abs_element);
+}
+
+static void fill_random_spd_row(int n, uint64_t seed, int row, double* lower, double* upper) {
+  fill_row_from_elements(n, seed, row, lower, upper, random_spd_element);
+}
+
+static void fill_banded_row(int n, uint64_t seed, int row, double* lower, double* upper) {
+  fill_row_from_elements(n, seed, row, lower, upper, banded_element);
+}
+
+static void fill_laplacian_row(int n, uint64_t seed, int row, double* lower, double* upper) {
+  fill_row_from_elements(n, seed, row, lower, upper, laplacian_element);
+}
+
+static void fill_indefinite_row(int n, uint64_t seed, int row, double* lower, double* upper) {
+  fill_row_from_elements(n, seed, row, lower, upper, indefinite_element);
+}
+
+static void fill_covariance_row(int n, uint64_t seed, int row, double* lower, double* upper) {
+  fill_row_from_elements(n, seed, row, lower, upper, covariance_element);
+}
+
+const MatrixGenerator matrix_generators[] = {
+    {"abs", "a(i, j) = n - max(i, j) (default test matrix)", fill_abs_row},
+    {"random_spd", "random entries in [-1, 1), diagonally dominant", fill_random_spd_row},
+    {"banded", "random entries within 16 of the diagonal, diagonally dominant", fill_banded_row},
+    {"laplacian", "2D 5-point Laplacian on a sqrt(n) wide grid", fill_laplacian_row},
+    {"indefinite", "random entries, diagonal of alternating sign", fill_indefinite_row},
+    {"covariance", "squared-exponential kernel, low-rank off-diagonal blocks", fill_covariance_row},
+};
+const int matrix_generator_count = sizeof(matrix_generators) / sizeof(matrix_generators[0]);
+
+const MatrixGenerator* find_matrix_generator(const char* name) {
+  int i;
+
+  for (i = 0; i < matrix_generator_count; ++i) {
+    if (strcmp(matrix_generators[i].name, name) == 0) return &matrix_generators[i];
+  }
+  return NULL;
+}
+
+typedef struct {
+  CholeskyMatrix* matrix;
+  const MatrixGenerator* generator;
+  uint64_t seed;
+  const double* vector_answer;
+  double* rhs;
+  int row_begin;
+  int row_end;
+  double* lower;  // Row buffer for the columns left of the diagonal.
+  double* upper;  // Row buffer for the rest when the matrix is not stored (else NULL).
+} GeneratorTask;
+
+static void* run_generator_task(void* arg) {
+  GeneratorTask* task = (GeneratorTask*)arg;
+  int n = task->matrix->size;
+  const double* x = task->vector_answer;
+  int i, j;
+
+  for (i = task->row_begin; i < task->row_end; ++i) {
+    double* upper =
+        (task->upper ? task->upper : task->matrix->data + get_symmetric_index(i, i, n));
+    double sum = 0;
+
+    task->generator->fill_row(n, task->seed, i, task->lower, upper);
+
+    for (j = 0; j < i; ++j) sum += task->lower[j] * x[j];
+    for (j = i; j < n; ++j) sum += upper[j - i] * x[j];
+    task->rhs[i] = sum;
+  }
+
+  return NULL;
+}
+
+int generate_matrix(CholeskyMatrix* matrix, const MatrixGenerator* generator, uint64_t seed,
+                    int thread_count, const double* vector_answer, double* rhs) {
+  int n = matrix->size;
+  GeneratorTask* tasks;
+  pthread_t* threads;
+  double* lower;
+  int row_buffers = (matrix->data ? 1 : 2);
+  int started, t;
+
+  if (thread_count > n) thread_count = n;
+  if (thread_count < 1) thread_count = 1;
+
+  tasks = (GeneratorTask*)malloc(thread_count * sizeof(GeneratorTask));
+  threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+  lower = (double*)malloc((size_t)thread_count * row_buffers * n * sizeof(double));
+  if (!tasks || !threads || !lower) {
+    free(tasks);
+    free(threads);
+    free(lower);
+    return -1;
+  }
+
+  // Every row evaluates all n elements (the lower part only for the RHS), so
+  // equal row counts are equal work.
+  for (t = 0; t < thread_count; ++t) {
+    tasks[t].matrix = matrix;
+    tasks[t].generator = generator;
+    tasks[t].seed = seed;
+    tasks[t].vector_answer = vector_answer;
+    tasks[t].rhs = rhs;
+    tasks[t].row_begin = (int)((long long)n * t / thread_count);
+    tasks[t].row_end = (int)((long long)n * (t + 1) / thread_count);
+    tasks[t].lower = lower + (size_t)t * row_buffers * n;
+    tasks[t].upper = (matrix->data ? NULL : tasks[t].lower + n);
+  }
+
+  for (started = 1; started < thread_count; ++started) {
+    if (pthread_create(&threads[started], NULL, run_generator_task, &tasks[started]) != 0) break;
+  }
+
+  // Rows of threads that could not be started are generated here.
+  run_generator_task(&tasks[0]);
+  for (t = started; t < thread_count; ++t) run_generator_task(&tasks[t]);
+  for (t = 1; t < started; ++t) pthread_join(threads[t], NULL);
+
+  free(tasks);
+  free(threads);
+  free(lower);
+  return 0;
+}
+
+int generate_matrix_rows(void* context, int row, int count, double* rows) {
+  const GeneratedMatrixRows* source = (const GeneratedMatrixRows*)context;
+  int n = source->size;
+  int width = n - row;
+  double* lower = (double*)malloc((n > 0 ? n : 1) * sizeof(double));
+  int r;
+
+  if (!lower) return -1;
+
+  for (r = 0; r < count; ++r) {
+    source->generator->fill_row(n, source->seed, row + r, lower, rows + (size_t)r * width + r);
+  }
+
+  free(lower);
+  return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef MATRIX_GENERATORS_H
+#define MATRIX_GENERATORS_H
+
+#include <stdint.h>
+
+#include "matrix_utils.h"
+
+// A family of synthetic test matrices.
+//
+// Every element is a pure function of (size, seed, row, column), so the
+// generated matrix does not depend on how the rows are split between threads.
+typedef struct {
+  const char* name;
+  const char* description;
+  // Generates row `row` of the symmetric n x n matrix: the columns [0, row)
+  // into lower and the columns [row, n) into upper (which points straight
+  // into the packed storage).
+  void (*fill_row)(int n, uint64_t seed, int row, double* lower, double* upper);
+} MatrixGenerator;
+
+// All registered generators; the first one is the default test matrix.
+extern const MatrixGenerator matrix_generators[];
+extern const int matrix_generator_count;
+
+// Looks a generator up by name.
+//
+// Args:
+//   name: Name of the generator family.
+//
+// Returns:
+//   The generator, or NULL if no family has this name.
+const MatrixGenerator* find_matrix_generator(const char* name);
+
+// Generates the matrix and the matching RHS for a known answer in one pass.
+//
+// Rows are split into ranges of equal work and handled by thread_count
+// threads. Each thread writes its rows of the packed matrix directly and
+// computes their RHS entries from the generated row, so the threads never
+// touch the same memory.
+//
+// Args:
+//   matrix: Pointer to the matrix structure to fill; with matrix->data NULL
+//     nothing is stored and only the RHS (A * vector_answer) is computed.
+//   generator: Matrix family.
+//   seed: Seed of the randomized families.
+//   thread_count: Number of threads (1 runs on the calling thread only).
+//   vector_answer: The known exact solution vector.
+//   rhs: Output buffer for the resulting right-hand side vector.
+//
+// Returns:
+//   0 on success, -1 if the row buffers could not be allocated.
+int generate_matrix(CholeskyMatrix* matrix, const MatrixGenerator* generator, uint64_t seed,
+                    int thread_count, const double* vector_answer, double* rhs);
+
+// A generated matrix read row by row without being stored (see generate_matrix_rows()).
+typedef struct {
+  const MatrixGenerator* generator;
+  int size;
+  uint64_t seed;
+} GeneratedMatrixRows;
+
+// Generates the rows [row, row + count) of a GeneratedMatrixRows context;
+// row row + r goes to rows + r * (size - row) as its columns [row, size).
+// Matches TlrRowSource.
+//
+// Args:
+//   context: GeneratedMatrixRows describing the matrix.
+//   row: First row.
+//   count: Number of rows.
+//   rows: Output buffer of count * (size - row) doubles.
+//
+// Returns:
+//   0 on success, -1 if the row buffer could not be allocated.
+int generate_matrix_rows(void* context, int row, int count, double* rows);
+
+#endif
@@ -2,12 +2,16 @@
 #define MATRIX_UTILS_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 typedef struct {
   int size;
   int block_size;
   double* data;
   double* diagonal;
+  int* pivots;  // Interchanges of the pivoted LDL^T mode (NULL for R^T D R).
+  int mapped;   // Non-zero if data/diagonal/pivots point into a factor_cache_load() mapping.
 } CholeskyMatrix;
 
 /**
@@ -31,4 +35,48 @@ static inline size_t get_symmetric_index(int row, int col, int n) {
   return (size_t)row * n - (size_t)row * (row - 1) / 2 + (col - row);
 }
 
+/**
+ * Initial value of the hashes below (FNV-1a offset basis).
+ */
+#define HASH_SEED 0xcbf29ce484222325ULL
+
+/**
+ * Mixes one 64-bit word into a running FNV-1a style hash.
+ * Start from HASH_SEED and finish with hash_finalize().
+ *
+ * The multiplication only carries bits upwards, so the high half is folded
+ * back down; otherwise two flips of the same top bit (e.g. the signs of two
+ * doubles) would cancel out.
+ */
+static inline uint64_t hash_word(uint64_t hash, uint64_t word) {
+  hash = (hash ^ word) * 0x100000001b3ULL;
+  return hash ^ (hash >> 32);
+}
+
+/**
+ * Final avalanche so that nearby inputs spread over the whole hash space.
+ */
+static inline uint64_t hash_finalize(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/**
+ * Hashes the bit patterns of count doubles; equal hashes mean bitwise
+ * identical arrays (up to collisions).
+ */
+static inline uint64_t hash_doubles(const double* values, size_t count) {
+  uint64_t hash = HASH_SEED;
+  size_t i;
+
+  for (i = 0; i < count; ++i) {
+    uint64_t word;
+    memcpy(&word, values + i, sizeof(word));
+    hash = hash_word(hash, word);
+  }
+  return hash_finalize(hash);
+}
+
 #endif
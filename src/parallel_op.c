@@ -0,0 +1,233 @@
+#include "parallel_op.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_kernels.h"
+#include "array_op.h"
+#include "matrix_utils.h"
+
+// Number of mutexes guarding the merges of the unordered mode (tiles share them round robin).
+#define TILE_LOCK_COUNT 64
+
+typedef struct {
+  CholeskyMatrix* matrix;
+  ReductionMode reduction;
+  int thread_count;
+  pthread_barrier_t barrier;
+  // Task counters of the update (0) and scaling (1) phases; reset while the
+  // diagonal block is factored, when neither phase is running.
+  int next_task[2];
+  int failed;
+  double* inverse;  // Inverse of the current diagonal block, shared by the scaling phase.
+  pthread_mutex_t tile_locks[TILE_LOCK_COUNT];
+  // Workers wait here until the final thread count is known and the barrier is set up.
+  pthread_mutex_t start_lock;
+  pthread_cond_t start_cond;
+  int started;
+} ParallelCholesky;
+
+typedef struct {
+  ParallelCholesky* shared;
+  int thread_index;
+  double* workspace;  // get_cholesky_workspace_size() doubles owned by this thread.
+} ParallelWorker;
+
+static inline int claim_task(ParallelCholesky* shared, int phase) {
+  return __atomic_fetch_add(&shared->next_task[phase], 1, __ATOMIC_RELAXED);
+}
+
+// Adds the staged tile c to the packed matrix (only the upper half on the diagonal).
+static void add_block_to_matrix_block(double* a, int row, int column, int matrix_size, int n,
+                                      int m, const double* c) {
+  int i, j;
+
+  for (i = 0; i < n; i++) {
+    double* pa = a + get_symmetric_index(row + i, column, matrix_size);
+    for (j = (row == column ? i : 0); j < m; j++) pa[j] += c[(size_t)i * m + j];
+  }
+}
+
+// Updates tile (i, j) with the contributions of all rows above it, in ascending order.
+CHOLESKY_TARGET_CLONES
+static void update_tile_ordered(const CholeskyMatrix* matrix, int i, int j, int rows, int columns,
+                                double* workspace) {
+  int block_size = matrix->block_size;
+  double* pair_buffers = workspace;
+  double* c = workspace + 4 * (size_t)block_size * block_size;
+
+  if (j != i)
+    cpy_matrix_block_to_block(matrix->data, i, j, matrix->size, rows, columns, c);
+  else
+    cpy_diagonal_block_to_block(matrix->data, i, matrix->size, rows, c);
+
+  update_tile(matrix, i, j, rows, columns, 0, i, pair_buffers, c);
+
+  if (j != i)
+    cpy_block_to_matrix_block(matrix->data, i, j, matrix->size, rows, columns, c);
+  else
+    cpy_block_to_diagonal_block(matrix->data, i, matrix->size, rows, c);
+}
+
+// Accumulates the contributions of rows [k_begin, k_end) to tile (i, j) privately
+// and merges them into the packed matrix under the tile's lock.
+CHOLESKY_TARGET_CLONES
+static void update_tile_chunk(ParallelCholesky* shared, int i, int j, int rows, int columns,
+                              int k_begin, int k_end, double* workspace) {
+  const CholeskyMatrix* matrix = shared->matrix;
+  int block_size = matrix->block_size;
+  double* pair_buffers = workspace;
+  double* c = workspace + 4 * (size_t)block_size * block_size;
+  pthread_mutex_t* lock = &shared->tile_locks[(j / block_size) % TILE_LOCK_COUNT];
+
+  memset(c, 0, (size_t)rows * columns * sizeof(double));
+  update_tile(matrix, i, j, rows, columns, k_begin, k_end, pair_buffers, c);
+
+  pthread_mutex_lock(lock);
+  add_block_to_matrix_block(matrix->data, i, j, matrix->size, rows, columns, c);
+  pthread_mutex_unlock(lock);
+}
+
+CHOLESKY_TARGET_CLONES
+static void* run_worker(void* arg) {
+  ParallelWorker* worker = (ParallelWorker*)arg;
+  ParallelCholesky* shared = worker->shared;
+  CholeskyMatrix* matrix = shared->matrix;
+  int matrix_size = matrix->size;
+  int block_size = matrix->block_size;
+  int block_count = (matrix_size + block_size - 1) / block_size;
+  double* mb = worker->workspace;
+  double* mc = worker->workspace + 4 * (size_t)block_size * block_size;
+  int i, task;
+
+  pthread_mutex_lock(&shared->start_lock);
+  while (!shared->started) pthread_cond_wait(&shared->start_cond, &shared->start_lock);
+  pthread_mutex_unlock(&shared->start_lock);
+
+  for (i = 0; i < matrix_size; i += block_size) {
+    int rows = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    int tile_count = block_count - i / block_size;
+    int chunk_count = 1, chunk_rows = i;
+
+    // Phase A: trailing updates of the tiles (i, j), j >= i.
+    if (shared->reduction == REDUCTION_UNORDERED && i > 0) {
+      // Split the rows above into chunks until every thread has about two tasks.
+      chunk_count = (2 * shared->thread_count + tile_count - 1) / tile_count;
+      if (chunk_count > i / block_size) chunk_count = i / block_size;
+      chunk_rows = ((i / block_size + chunk_count - 1) / chunk_count) * block_size;
+      chunk_count = (i + chunk_rows - 1) / chunk_rows;
+    }
+
+    while ((task = claim_task(shared, 0)) < tile_count * chunk_count) {
+      int j = i + (task / chunk_count) * block_size;
+      int columns = (j + block_size < matrix_size ? block_size : matrix_size - j);
+
+      if (shared->reduction == REDUCTION_ORDERED) {
+        update_tile_ordered(matrix, i, j, rows, columns, worker->workspace);
+      } else if (i > 0) {
+        int k_begin = (task % chunk_count) * chunk_rows;
+        int k_end = (k_begin + chunk_rows < i ? k_begin + chunk_rows : i);
+        update_tile_chunk(shared, i, j, rows, columns, k_begin, k_end, worker->workspace);
+      }
+    }
+    pthread_barrier_wait(&shared->barrier);
+
+    // Phase B: the diagonal block, always on the same thread.
+    if (worker->thread_index == 0) {
+      cpy_diagonal_block_to_block(matrix->data, i, matrix_size, rows, mb);
+      if (cholesky_for_block(rows, mb, matrix->diagonal + i)) {
+        shared->failed = 1;
+      } else {
+        cpy_block_to_diagonal_block(matrix->data, i, matrix_size, rows, mb);
+        if (inverse_upper_triangle_block_and_diagonal(rows, mb, matrix->diagonal + i,
+                                                      shared->inverse))
+          shared->failed = 1;
+      }
+      shared->next_task[0] = 0;
+      shared->next_task[1] = 0;
+    }
+    pthread_barrier_wait(&shared->barrier);
+    if (shared->failed) break;
+
+    // Phase C: scaling of the off-diagonal tiles of the row.
+    while ((task = claim_task(shared, 1)) < tile_count - 1) {
+      int j = i + (task + 1) * block_size;
+      int columns = (j + block_size < matrix_size ? block_size : matrix_size - j);
+
+      cpy_matrix_block_to_block(matrix->data, i, j, matrix_size, rows, columns, mb);
+      main_blocks_multiply(rows, rows, columns, shared->inverse, mb, mc);
+      cpy_block_to_matrix_block(matrix->data, i, j, matrix_size, rows, columns, mc);
+    }
+    pthread_barrier_wait(&shared->barrier);
+  }
+
+  return NULL;
+}
+
+int cholesky_parallel(CholeskyMatrix* matrix, int thread_count, ReductionMode reduction) {
+  int block_size = matrix->block_size;
+  size_t workspace_size = get_cholesky_workspace_size(block_size);
+  ParallelCholesky shared;
+  ParallelWorker* workers = NULL;
+  pthread_t* threads = NULL;
+  double* workspaces = NULL;
+  int started = 0, return_code = 0, t;
+
+  memset(&shared, 0, sizeof(shared));
+  shared.matrix = matrix;
+  shared.reduction = reduction;
+  shared.thread_count = thread_count;
+
+  workers = (ParallelWorker*)malloc(thread_count * sizeof(ParallelWorker));
+  threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+  workspaces = (double*)calloc(thread_count * workspace_size + (size_t)block_size * block_size,
+                               sizeof(double));
+  if (!workers || !threads || !workspaces) {
+    free(workers);
+    free(threads);
+    free(workspaces);
+    return -2;
+  }
+  shared.inverse = workspaces + thread_count * workspace_size;
+
+  pthread_mutex_init(&shared.start_lock, NULL);
+  pthread_cond_init(&shared.start_cond, NULL);
+  for (t = 0; t < TILE_LOCK_COUNT; ++t) pthread_mutex_init(&shared.tile_locks[t], NULL);
+
+  for (t = 0; t < thread_count; ++t) {
+    workers[t].shared = &shared;
+    workers[t].thread_index = t;
+    workers[t].workspace = workspaces + t * workspace_size;
+  }
+
+  // The calling thread is worker 0. If some threads cannot be started the
+  // factorization proceeds with the ones that were; the ordered result does
+  // not depend on the thread count anyway.
+  for (t = 1; t < thread_count; ++t) {
+    if (pthread_create(&threads[t], NULL, run_worker, &workers[t]) != 0) break;
+  }
+  started = t;
+
+  shared.thread_count = started;
+  pthread_barrier_init(&shared.barrier, NULL, started);
+  pthread_mutex_lock(&shared.start_lock);
+  shared.started = 1;
+  pthread_cond_broadcast(&shared.start_cond);
+  pthread_mutex_unlock(&shared.start_lock);
+
+  run_worker(&workers[0]);
+  for (t = 1; t < started; ++t) pthread_join(threads[t], NULL);
+
+  if (shared.failed) return_code = -1;
+
+  pthread_barrier_destroy(&shared.barrier);
+  pthread_cond_destroy(&shared.start_cond);
+  pthread_mutex_destroy(&shared.start_lock);
+  for (t = 0; t < TILE_LOCK_COUNT; ++t) pthread_mutex_destroy(&shared.tile_locks[t]);
+  free(workers);
+  free(threads);
+  free(workspaces);
+
+  return return_code;
+}
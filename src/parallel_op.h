@@ -0,0 +1,36 @@
+#ifndef PARALLEL_OP_H
+#define PARALLEL_OP_H
+
+#include "matrix_utils.h"
+
+// How the trailing update of a tile is reduced across threads.
+typedef enum {
+  // Each tile is updated by exactly one thread with the contributions of the
+  // rows above it accumulated in ascending order. The factor is bitwise
+  // identical to cholesky() for every thread count.
+  REDUCTION_ORDERED,
+  // The contributions to a tile are split into chunks of rows handled by
+  // different threads and merged in whatever order the chunks finish. Exposes
+  // more parallelism near the end of the factorization, but the rounding (and
+  // therefore the factor) may differ from run to run.
+  REDUCTION_UNORDERED
+} ReductionMode;
+
+// Performs the block Cholesky decomposition A = R^T D R with thread_count threads.
+//
+// Every block row is processed as a statically ordered DAG of three phases
+// separated by barriers: trailing updates of the tiles of the row, the
+// factorization of its diagonal block and the scaling of the off-diagonal tiles.
+// Workspaces are allocated per thread.
+//
+// Args:
+//   matrix: Pointer to the CholeskyMatrix structure.
+//   thread_count: Number of worker threads (1 runs on the calling thread only).
+//   reduction: Reduction order of the trailing updates.
+//
+// Returns:
+//   0 on success, -1 if the matrix is singular or not positive definite,
+//   -2 if the workspaces could not be allocated.
+int cholesky_parallel(CholeskyMatrix* matrix, int thread_count, ReductionMode reduction);
+
+#endif
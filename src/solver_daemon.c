@@ -0,0 +1,809 @@
+#define _GNU_SOURCE
+
+#include "solver_daemon.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "array_io.h"
+#include "array_op.h"
+#include "matrix_utils.h"
+
+#define DAEMON_MAX_CLIENTS 64
+#define DAEMON_NAME_LENGTH 64
+#define DAEMON_PATH_LENGTH 1024
+#define DAEMON_LINE_LENGTH 4096
+
+typedef enum {
+  REQUEST_FACTOR,
+  REQUEST_SOLVE,
+  REQUEST_DROP,
+  REQUEST_STATS,
+  REQUEST_SHUTDOWN,
+} DaemonRequestType;
+
+typedef struct {
+  int fd;  // -1 when the slot is free.
+  char buffer[DAEMON_LINE_LENGTH];
+  size_t length;
+} DaemonClient;
+
+typedef struct {
+  DaemonRequestType type;
+  int client_fd;  // -1 once the client has disconnected.
+  char name[DAEMON_NAME_LENGTH];
+  int size;
+  int block_size;
+  char source[DAEMON_PATH_LENGTH];
+  char output[DAEMON_PATH_LENGTH];
+  double enqueue_time;
+  int running;  // FACTOR executing on the worker thread.
+  int done;
+} DaemonRequest;
+
+typedef struct ResidentFactor {
+  char name[DAEMON_NAME_LENGTH];
+  CholeskyMatrix matrix;
+  struct ResidentFactor* next;
+} ResidentFactor;
+
+typedef enum {
+  FACTOR_JOB_OK,
+  FACTOR_JOB_NO_MEMORY,
+  FACTOR_JOB_LOAD_FAILED,
+  FACTOR_JOB_DECOMPOSITION_FAILED,
+} FactorJobResult;
+
+// A FACTOR executing on the worker thread. The worker only touches the job and
+// its (not yet resident) factor; the poll loop joins it, installs the factor
+// and answers the request after the worker has written to the wake pipe.
+typedef struct {
+  pthread_t thread;
+  int active;    // A worker has been started and not joined yet.
+  int finished;  // The wake pipe signalled that the worker is done.
+  int wake_fd;   // Write end of the wake pipe.
+  ResidentFactor* factor;
+  char source[DAEMON_PATH_LENGTH];
+  double start_time;
+  FactorJobResult result;
+} FactorJob;
+
+typedef struct {
+  long requests;          // Requests answered (OK or ERROR).
+  long solves;            // Right-hand sides solved.
+  long batches;           // Multi right-hand side solves executed.
+  long factors;           // Factorizations computed.
+  double queue_time_sum;  // Sum of (start of processing - arrival) over all requests.
+  double queue_time_max;
+  double latency_sum;  // Sum of (response - arrival) over all requests.
+  double start_time;
+} DaemonStats;
+
+typedef struct {
+  const DaemonConfig* config;
+  int listen_fd;
+  DaemonClient clients[DAEMON_MAX_CLIENTS];
+  DaemonRequest* queue;
+  size_t queue_count;
+  size_t queue_capacity;
+  ResidentFactor* factors;
+  double* batch_buffer;
+  size_t batch_buffer_size;
+  DaemonStats stats;
+  FactorJob factor_job;
+  int wake_pipe[2];
+  int shutdown;
+} DaemonState;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Sends one response line and accounts the request in the statistics.
+static void respond(DaemonState* state, DaemonRequest* request, const char* format, ...) {
+  char line[DAEMON_LINE_LENGTH];
+  va_list args;
+  int length;
+
+  va_start(args, format);
+  length = vsnprintf(line, sizeof(line) - 1, format, args);
+  va_end(args);
+  if (length < 0) length = 0;
+  if (length > (int)sizeof(line) - 2) length = sizeof(line) - 2;
+  line[length++] = '\n';
+
+  if (request->client_fd >= 0) send(request->client_fd, line, length, MSG_NOSIGNAL);
+
+  request->done = 1;
+  state->stats.requests++;
+  state->stats.latency_sum += now_seconds() - request->enqueue_time;
+}
+
+static void account_queue_time(DaemonState* state, const DaemonRequest* request, double start) {
+  double queue_time = start - request->enqueue_time;
+
+  state->stats.queue_time_sum += queue_time;
+  if (queue_time > state->stats.queue_time_max) state->stats.queue_time_max = queue_time;
+}
+
+// Opens "shm:/<object>" as POSIX shared memory and anything else as a regular file.
+static int open_source(const char* source, int flags) {
+  if (strncmp(source, "shm:", 4) == 0) return shm_open(source + 4, flags, 0600);
+  return open(source, flags, 0644);
+}
+
+static int read_exact(int fd, void* buffer, size_t length) {
+  char* p = (char*)buffer;
+  off_t offset = 0;
+
+  while (length > 0) {
+    ssize_t count = pread(fd, p, length, offset);
+    if (count <= 0) return -1;
+    p += count;
+    offset += count;
+    length -= (size_t)count;
+  }
+
+  return 0;
+}
+
+static int write_exact(int fd, const void* buffer, size_t length) {
+  const char* p = (const char*)buffer;
+  off_t offset = 0;
+
+  while (length > 0) {
+    ssize_t count = pwrite(fd, p, length, offset);
+    if (count <= 0) return -1;
+    p += count;
+    offset += count;
+    length -= (size_t)count;
+  }
+
+  return 0;
+}
+
+static int read_vector(const char* source, int n, double* vector) {
+  int fd = open_source(source, O_RDONLY);
+  int return_code;
+
+  if (fd < 0) return -1;
+  return_code = read_exact(fd, vector, (size_t)n * sizeof(double));
+  close(fd);
+  return return_code;
+}
+
+// Writes over an existing file or shared memory object of exactly n doubles; the
+// daemon never creates or resizes a path named by a client.
+static int write_vector(const char* destination, int n, const double* vector) {
+  int fd = open_source(destination, O_RDWR);
+  size_t length = (size_t)n * sizeof(double);
+  struct stat status;
+  int return_code;
+
+  if (fd < 0) return -1;
+  return_code = fstat(fd, &status) || (size_t)status.st_size != length ||
+                write_exact(fd, vector, length);
+  close(fd);
+  return return_code;
+}
+
+static ResidentFactor* find_factor(DaemonState* state, const char* name) {
+  ResidentFactor* factor;
+
+  for (factor = state->factors; factor; factor = factor->next) {
+    if (strcmp(factor->name, name) == 0) return factor;
+  }
+
+  return NULL;
+}
+
+static void free_factor(ResidentFactor* factor) {
+  if (factor->matrix.data) free(factor->matrix.data);
+  if (factor->matrix.diagonal) free(factor->matrix.diagonal);
+  free(factor);
+}
+
+static int drop_factor(DaemonState* state, const char* name) {
+  ResidentFactor** link;
+
+  for (link = &state->factors; *link; link = &(*link)->next) {
+    if (strcmp((*link)->name, name) == 0) {
+      ResidentFactor* factor = *link;
+      *link = factor->next;
+      free_factor(factor);
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+// Fills matrix->data from the request source.
+static int load_matrix(const char* source, CholeskyMatrix* matrix) {
+  int n = matrix->size;
+  double *answer, *rhs;
+  int return_code;
+
+  if (strncmp(source, "shm:", 4) == 0) {
+    int fd = open_source(source, O_RDONLY);
+    if (fd < 0) return -1;
+    return_code = read_exact(fd, matrix->data, get_symmetric_matrix_size(n) * sizeof(double));
+    close(fd);
+    return return_code;
+  }
+
+  // The loaders also build a right-hand side; it is not needed here.
+  answer = (double*)calloc(n, sizeof(double));
+  rhs = (double*)calloc(n, sizeof(double));
+  if (!answer || !rhs) {
+    return_code = -2;
+  } else if (strcmp(source, "generate") == 0) {
+    return_code = fill_matrix(matrix, answer, rhs);
+  } else {
+    return_code = read_matrix(matrix, answer, rhs, source);
+  }
+
+  if (answer) free(answer);
+  if (rhs) free(rhs);
+  return return_code;
+}
+
+static void* run_factor_job(void* arg) {
+  FactorJob* job = (FactorJob*)arg;
+  CholeskyMatrix* matrix = &job->factor->matrix;
+  double* workspace = (double*)calloc(get_cholesky_workspace_size(matrix->block_size),
+                                      sizeof(double));
+  char wake = 0;
+
+  // Only the decomposition needs a workspace; the solves stream the packed factor.
+  if (!workspace)
+    job->result = FACTOR_JOB_NO_MEMORY;
+  else if (load_matrix(job->source, matrix))
+    job->result = FACTOR_JOB_LOAD_FAILED;
+  else if (cholesky(matrix, workspace))
+    job->result = FACTOR_JOB_DECOMPOSITION_FAILED;
+  else
+    job->result = FACTOR_JOB_OK;
+
+  if (workspace) free(workspace);
+  while (write(job->wake_fd, &wake, 1) < 0 && errno == EINTR) {
+  }
+  return NULL;
+}
+
+// Starts the decomposition of a FACTOR request on the worker thread, so that
+// solves against other resident factors are served while it runs.
+static void start_factor(DaemonState* state, DaemonRequest* request) {
+  FactorJob* job = &state->factor_job;
+  int n = request->size;
+  int m = request->block_size;
+  ResidentFactor* factor;
+
+  job->start_time = now_seconds();
+  account_queue_time(state, request, job->start_time);
+
+  if (n <= 0 || m <= 0 || m > n) {
+    respond(state, request, "ERROR invalid size %d or block size %d", n, m);
+    return;
+  }
+
+  factor = (ResidentFactor*)calloc(1, sizeof(ResidentFactor));
+  if (!factor) {
+    respond(state, request, "ERROR out of memory");
+    return;
+  }
+
+  snprintf(factor->name, sizeof(factor->name), "%s", request->name);
+  factor->matrix.size = n;
+  factor->matrix.block_size = m;
+  factor->matrix.data = (double*)calloc(get_symmetric_matrix_size(n), sizeof(double));
+  factor->matrix.diagonal = (double*)calloc(n, sizeof(double));
+
+  if (!factor->matrix.data || !factor->matrix.diagonal) {
+    free_factor(factor);
+    respond(state, request, "ERROR out of memory");
+    return;
+  }
+
+  job->factor = factor;
+  job->finished = 0;
+  snprintf(job->source, sizeof(job->source), "%s", request->source);
+  if (pthread_create(&job->thread, NULL, run_factor_job, job) != 0) {
+    free_factor(factor);
+    respond(state, request, "ERROR cannot start factor thread");
+    return;
+  }
+
+  job->active = 1;
+  request->running = 1;
+}
+
+// Joins the finished worker and answers its FACTOR request.
+static void finish_factor(DaemonState* state, DaemonRequest* request) {
+  FactorJob* job = &state->factor_job;
+  ResidentFactor* factor = job->factor;
+
+  pthread_join(job->thread, NULL);
+  job->active = 0;
+  job->finished = 0;
+  job->factor = NULL;
+  request->running = 0;
+
+  switch (job->result) {
+    case FACTOR_JOB_OK:
+      break;
+    case FACTOR_JOB_NO_MEMORY:
+      free_factor(factor);
+      respond(state, request, "ERROR out of memory");
+      return;
+    case FACTOR_JOB_LOAD_FAILED:
+      free_factor(factor);
+      respond(state, request, "ERROR cannot load matrix from '%s'", request->source);
+      return;
+    case FACTOR_JOB_DECOMPOSITION_FAILED:
+      free_factor(factor);
+      respond(state, request, "ERROR decomposition failed");
+      return;
+  }
+
+  // Re-factoring under an existing name replaces the resident factor.
+  drop_factor(state, request->name);
+  factor->next = state->factors;
+  state->factors = factor;
+  state->stats.factors++;
+
+  respond(state, request, "OK factor %s time_ms=%.3f", request->name,
+          (now_seconds() - job->start_time) * 1e3);
+}
+
+// Solves the SOLVE request at queue[first] together with every later queued
+// SOLVE against the same factor, up to max_batch right-hand sides. Collection
+// stops at a FACTOR or DROP of that name and at any SHUTDOWN so that request
+// order is preserved.
+static void handle_solve_batch(DaemonState* state, size_t first) {
+  DaemonRequest* head = &state->queue[first];
+  ResidentFactor* factor = find_factor(state, head->name);
+  double start = now_seconds();
+  size_t members[DAEMON_MAX_CLIENTS * 4];
+  int max_batch = state->config->max_batch;
+  int member_count = 0, rhs_count = 0, n, i;
+  size_t index;
+
+  if (max_batch <= 0 || max_batch > (int)(sizeof(members) / sizeof(members[0])))
+    max_batch = sizeof(members) / sizeof(members[0]);
+
+  if (!factor) {
+    account_queue_time(state, head, start);
+    respond(state, head, "ERROR unknown factor '%s'", head->name);
+    return;
+  }
+
+  for (index = first; index < state->queue_count && member_count < max_batch; ++index) {
+    DaemonRequest* request = &state->queue[index];
+
+    if (request->done) continue;
+    if (request->type == REQUEST_SHUTDOWN) break;
+    if (strcmp(request->name, head->name) != 0) continue;
+    if (request->type == REQUEST_FACTOR || request->type == REQUEST_DROP) break;
+    if (request->type == REQUEST_SOLVE) members[member_count++] = index;
+  }
+
+  n = factor->matrix.size;
+  if (state->batch_buffer_size < (size_t)member_count * n) {
+    double* grown =
+        (double*)realloc(state->batch_buffer, (size_t)member_count * n * sizeof(double));
+    if (!grown) {
+      for (i = 0; i < member_count; ++i) {
+        account_queue_time(state, &state->queue[members[i]], start);
+        respond(state, &state->queue[members[i]], "ERROR out of memory");
+      }
+      return;
+    }
+    state->batch_buffer = grown;
+    state->batch_buffer_size = (size_t)member_count * n;
+  }
+
+  // Gather the right-hand sides; unreadable ones are answered right away.
+  for (i = 0; i < member_count; ++i) {
+    DaemonRequest* request = &state->queue[members[i]];
+
+    account_queue_time(state, request, start);
+    if (read_vector(request->source, n, state->batch_buffer + (size_t)rhs_count * n)) {
+      respond(state, request, "ERROR cannot read right-hand side from '%s'", request->source);
+      continue;
+    }
+    members[rhs_count++] = members[i];
+  }
+
+  if (rhs_count == 0) return;
+
+  if (solve_lower_triangle_matrix_system_multi(&factor->matrix, state->batch_buffer, rhs_count) ||
+      solve_upper_triangle_matrix_diagonal_system_multi(&factor->matrix, state->batch_buffer,
+                                                        rhs_count)) {
+    for (i = 0; i < rhs_count; ++i)
+      respond(state, &state->queue[members[i]], "ERROR solve failed");
+    return;
+  }
+
+  state->stats.batches++;
+  state->stats.solves += rhs_count;
+
+  for (i = 0; i < rhs_count; ++i) {
+    DaemonRequest* request = &state->queue[members[i]];
+    const char* destination = request->output[0] ? request->output : request->source;
+
+    if (write_vector(destination, n, state->batch_buffer + (size_t)i * n)) {
+      respond(state, request, "ERROR cannot write solution to '%s' (must exist and hold %d doubles)",
+              destination, n);
+    } else {
+      respond(state, request, "OK solve %s batch=%d queue_ms=%.3f", request->name, rhs_count,
+              (start - request->enqueue_time) * 1e3);
+    }
+  }
+}
+
+static void handle_stats(DaemonState* state, DaemonRequest* request) {
+  const DaemonStats* stats = &state->stats;
+  double uptime = now_seconds() - stats->start_time;
+  long answered = stats->requests > 0 ? stats->requests : 1;
+
+  account_queue_time(state, request, now_seconds());
+  respond(state, request,
+          "OK stats requests=%ld factors=%ld solves=%ld batches=%ld avg_batch=%.2f "
+          "mean_queue_ms=%.3f max_queue_ms=%.3f mean_latency_ms=%.3f throughput_rps=%.2f",
+          stats->requests, stats->factors, stats->solves, stats->batches,
+          stats->batches ? (double)stats->solves / stats->batches : 0.0,
+          stats->queue_time_sum / answered * 1e3, stats->queue_time_max * 1e3,
+          stats->latency_sum / answered * 1e3, uptime > 0 ? stats->requests / uptime : 0.0);
+}
+
+// Returns whether the request at queue[index] has to stay queued: requests wait
+// behind an unfinished FACTOR of the same name and behind a pending SHUTDOWN,
+// and SHUTDOWN waits for every request queued before it, so that results
+// follow the request order.
+static int must_wait(const DaemonState* state, size_t index) {
+  const DaemonRequest* request = &state->queue[index];
+  size_t earlier;
+
+  if (request->type == REQUEST_STATS) return 0;
+
+  for (earlier = 0; earlier < index; ++earlier) {
+    const DaemonRequest* other = &state->queue[earlier];
+
+    if (other->done) continue;
+    if (request->type == REQUEST_SHUTDOWN || other->type == REQUEST_SHUTDOWN) return 1;
+    if (other->type == REQUEST_FACTOR && strcmp(other->name, request->name) == 0) return 1;
+  }
+
+  return 0;
+}
+
+static void process_queue(DaemonState* state) {
+  size_t index, kept = 0;
+
+  for (index = 0; index < state->queue_count; ++index) {
+    DaemonRequest* request = &state->queue[index];
+
+    if (request->done) continue;
+
+    if (request->running) {
+      if (state->factor_job.finished) finish_factor(state, request);
+      continue;
+    }
+
+    if (state->shutdown) {
+      respond(state, request, "ERROR shutting down");
+      continue;
+    }
+
+    if (must_wait(state, index)) continue;
+
+    switch (request->type) {
+      case REQUEST_FACTOR:
+        // One decomposition runs at a time; later ones stay queued.
+        if (!state->factor_job.active) start_factor(state, request);
+        break;
+      case REQUEST_SOLVE:
+        handle_solve_batch(state, index);
+        break;
+      case REQUEST_DROP:
+        account_queue_time(state, request, now_seconds());
+        if (drop_factor(state, request->name))
+          respond(state, request, "ERROR unknown factor '%s'", request->name);
+        else
+          respond(state, request, "OK drop %s", request->name);
+        break;
+      case REQUEST_STATS:
+        handle_stats(state, request);
+        break;
+      case REQUEST_SHUTDOWN:
+        account_queue_time(state, request, now_seconds());
+        respond(state, request, "OK shutdown");
+        state->shutdown = 1;
+        break;
+    }
+  }
+
+  for (index = 0; index < state->queue_count; ++index) {
+    if (!state->queue[index].done) state->queue[kept++] = state->queue[index];
+  }
+  state->queue_count = kept;
+}
+
+static int has_pending_solve(const DaemonState* state) {
+  size_t index;
+
+  for (index = 0; index < state->queue_count; ++index) {
+    if (state->queue[index].type == REQUEST_SOLVE) return 1;
+  }
+
+  return 0;
+}
+
+// Parses one request line and appends it to the queue.
+static void enqueue_line(DaemonState* state, int client_fd, const char* line) {
+  DaemonRequest request;
+  char command[16];
+  int fields;
+
+  memset(&request, 0, sizeof(request));
+  request.client_fd = client_fd;
+  request.enqueue_time = now_seconds();
+
+  fields = sscanf(line, "%15s", command);
+  if (fields != 1) return;
+
+  if (strcmp(command, "FACTOR") == 0) {
+    request.type = REQUEST_FACTOR;
+    fields = sscanf(line, "%*s %63s %d %d %1023s", request.name, &request.size,
+                    &request.block_size, request.source);
+    if (fields != 4) fields = -1;
+  } else if (strcmp(command, "SOLVE") == 0) {
+    request.type = REQUEST_SOLVE;
+    fields = sscanf(line, "%*s %63s %1023s %1023s", request.name, request.source, request.output);
+    if (fields < 2) fields = -1;
+  } else if (strcmp(command, "DROP") == 0) {
+    request.type = REQUEST_DROP;
+    fields = sscanf(line, "%*s %63s", request.name);
+    if (fields != 1) fields = -1;
+  } else if (strcmp(command, "STATS") == 0) {
+    request.type = REQUEST_STATS;
+  } else if (strcmp(command, "SHUTDOWN") == 0) {
+    request.type = REQUEST_SHUTDOWN;
+  } else {
+    fields = -1;
+  }
+
+  if (fields < 0) {
+    respond(state, &request, "ERROR malformed request '%s'", line);
+    return;
+  }
+
+  if (state->queue_count == state->queue_capacity) {
+    size_t new_capacity = state->queue_capacity ? 2 * state->queue_capacity : 64;
+    DaemonRequest* grown =
+        (DaemonRequest*)realloc(state->queue, new_capacity * sizeof(DaemonRequest));
+    if (!grown) {
+      respond(state, &request, "ERROR out of memory");
+      return;
+    }
+    state->queue = grown;
+    state->queue_capacity = new_capacity;
+  }
+
+  state->queue[state->queue_count++] = request;
+}
+
+static void close_client(DaemonState* state, DaemonClient* client) {
+  size_t index;
+
+  // Requests already queued are still executed; their responses are dropped.
+  for (index = 0; index < state->queue_count; ++index) {
+    if (state->queue[index].client_fd == client->fd) state->queue[index].client_fd = -1;
+  }
+
+  close(client->fd);
+  client->fd = -1;
+  client->length = 0;
+}
+
+static void read_client(DaemonState* state, DaemonClient* client) {
+  ssize_t count = recv(client->fd, client->buffer + client->length,
+                       sizeof(client->buffer) - 1 - client->length, 0);
+  char *line, *newline;
+
+  if (count <= 0) {
+    if (count < 0 && (errno == EINTR || errno == EAGAIN)) return;
+    close_client(state, client);
+    return;
+  }
+
+  client->length += (size_t)count;
+  client->buffer[client->length] = '\0';
+
+  line = client->buffer;
+  while ((newline = strchr(line, '\n')) != NULL) {
+    *newline = '\0';
+    if (newline > line && newline[-1] == '\r') newline[-1] = '\0';
+    if (*line) enqueue_line(state, client->fd, line);
+    line = newline + 1;
+  }
+
+  client->length -= (size_t)(line - client->buffer);
+  memmove(client->buffer, line, client->length);
+
+  if (client->length == sizeof(client->buffer) - 1) {
+    DaemonRequest request;
+    memset(&request, 0, sizeof(request));
+    request.client_fd = client->fd;
+    request.enqueue_time = now_seconds();
+    respond(state, &request, "ERROR request line too long");
+    client->length = 0;
+  }
+}
+
+static void accept_client(DaemonState* state) {
+  int fd = accept(state->listen_fd, NULL, NULL);
+  int i;
+
+  if (fd < 0) return;
+
+  for (i = 0; i < DAEMON_MAX_CLIENTS; ++i) {
+    if (state->clients[i].fd < 0) {
+      state->clients[i].fd = fd;
+      state->clients[i].length = 0;
+      return;
+    }
+  }
+
+  close(fd);
+}
+
+// Waits up to timeout for socket activity or a finished factor job and enqueues
+// every complete request line.
+static void poll_sockets(DaemonState* state, const struct timespec* timeout) {
+  struct pollfd fds[DAEMON_MAX_CLIENTS + 2];
+  int slots[DAEMON_MAX_CLIENTS + 2];
+  int count = 0, i;
+
+  fds[count].fd = state->listen_fd;
+  fds[count].events = POLLIN;
+  slots[count++] = -1;
+
+  fds[count].fd = state->wake_pipe[0];
+  fds[count].events = POLLIN;
+  slots[count++] = -2;
+
+  for (i = 0; i < DAEMON_MAX_CLIENTS; ++i) {
+    if (state->clients[i].fd < 0) continue;
+    fds[count].fd = state->clients[i].fd;
+    fds[count].events = POLLIN;
+    slots[count++] = i;
+  }
+
+  if (ppoll(fds, count, timeout, NULL) <= 0) return;
+
+  for (i = 0; i < count; ++i) {
+    if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+    if (slots[i] == -2) {
+      char wake;
+      if (read(state->wake_pipe[0], &wake, 1) == 1) state->factor_job.finished = 1;
+    } else if (slots[i] < 0) {
+      accept_client(state);
+    } else if (state->clients[slots[i]].fd >= 0) {
+      read_client(state, &state->clients[slots[i]]);
+    }
+  }
+}
+
+int run_solver_daemon(const DaemonConfig* config) {
+  DaemonState state;
+  struct sockaddr_un address;
+  struct stat path_status;
+  struct timespec window;
+  ResidentFactor* factor;
+  int i;
+
+  memset(&state, 0, sizeof(state));
+  state.config = config;
+  for (i = 0; i < DAEMON_MAX_CLIENTS; ++i) state.clients[i].fd = -1;
+
+  if (strlen(config->socket_path) >= sizeof(address.sun_path)) {
+    printf("Error: socket path '%s' is too long\n", config->socket_path);
+    return -1;
+  }
+
+  // Only a stale socket may be replaced; never delete a file that happens to
+  // sit at the given path.
+  if (lstat(config->socket_path, &path_status) == 0) {
+    if (!S_ISSOCK(path_status.st_mode)) {
+      printf("Error: '%s' exists and is not a socket\n", config->socket_path);
+      return -1;
+    }
+    unlink(config->socket_path);
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, config->socket_path);
+
+  if (pipe(state.wake_pipe) != 0) {
+    printf("Error: cannot create wake pipe\n");
+    return -2;
+  }
+  state.factor_job.wake_fd = state.wake_pipe[1];
+
+  state.listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (state.listen_fd < 0) {
+    printf("Error: cannot create socket\n");
+    close(state.wake_pipe[0]);
+    close(state.wake_pipe[1]);
+    return -2;
+  }
+
+  if (bind(state.listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+      listen(state.listen_fd, DAEMON_MAX_CLIENTS) != 0) {
+    printf("Error: cannot listen on '%s'\n", config->socket_path);
+    close(state.listen_fd);
+    close(state.wake_pipe[0]);
+    close(state.wake_pipe[1]);
+    return -3;
+  }
+
+  state.stats.start_time = now_seconds();
+  printf("Daemon: listening on %s\n", config->socket_path);
+  fflush(stdout);
+
+  while (!state.shutdown) {
+    poll_sockets(&state, NULL);
+
+    // Give concurrent callers a chance to join the batch before solving.
+    if (config->batch_window_us > 0 && has_pending_solve(&state)) {
+      double deadline = now_seconds() + config->batch_window_us / 1e6;
+      double remaining;
+
+      while ((remaining = deadline - now_seconds()) > 0) {
+        window.tv_sec = (time_t)remaining;
+        window.tv_nsec = (long)((remaining - window.tv_sec) * 1e9);
+        poll_sockets(&state, &window);
+      }
+    }
+
+    process_queue(&state);
+  }
+
+  printf("Daemon: requests=%ld factors=%ld solves=%ld batches=%ld\n", state.stats.requests,
+         state.stats.factors, state.stats.solves, state.stats.batches);
+
+  for (i = 0; i < DAEMON_MAX_CLIENTS; ++i) {
+    if (state.clients[i].fd >= 0) close(state.clients[i].fd);
+  }
+  close(state.listen_fd);
+  close(state.wake_pipe[0]);
+  close(state.wake_pipe[1]);
+  unlink(config->socket_path);
+
+  while ((factor = state.factors) != NULL) {
+    state.factors = factor->next;
+    free_factor(factor);
+  }
+  if (state.queue) free(state.queue);
+  if (state.batch_buffer) free(state.batch_buffer);
+
+  return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef SOLVER_DAEMON_H
+#define SOLVER_DAEMON_H
+
+// Configuration for the long-running solver daemon.
+typedef struct {
+  const char* socket_path;  // Unix-domain socket to listen on.
+  int max_batch;            // Upper bound on right-hand sides coalesced into one solve.
+  int batch_window_us;      // How long to wait for more solves once one is queued.
+} DaemonConfig;
+
+// Serves factor/solve requests over a Unix-domain socket until SHUTDOWN is received.
+//
+// The protocol is line based; every request receives exactly one response line
+// starting with "OK" or "ERROR":
+//
+//   FACTOR <name> <size> <block_size> <source>
+//       Loads a matrix and keeps its factor resident under <name>. <source> is
+//       "generate" (the built-in test matrix), "shm:/<object>" (packed upper
+//       triangle as raw doubles in POSIX shared memory) or a text file in the
+//       format accepted by the command line solver. The decomposition runs on a
+//       worker thread (one at a time); requests naming other factors are served
+//       meanwhile, later requests naming <name> wait for it.
+//   SOLVE <name> <rhs> [<output>]
+//       Solves A x = b against a resident factor. <rhs> is "shm:/<object>" or a
+//       file holding <size> raw doubles; the solution is written to <output>
+//       (same syntax) or, if omitted, over <rhs>. <output> must already exist
+//       and hold exactly <size> doubles.
+//   DROP <name>
+//   STATS
+//   SHUTDOWN
+//       Answered once every earlier request has been answered.
+//
+// Queued SOLVE requests against the same factor are coalesced into a single
+// multi right-hand side solve. A stale socket at socket_path is replaced; any
+// other file there is an error.
+//
+// Args:
+//   config: Daemon configuration.
+//
+// Returns:
+//   0 after a clean shutdown, non-zero if the socket could not be set up.
+int run_solver_daemon(const DaemonConfig* config);
+
+#endif
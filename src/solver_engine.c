@@ -7,49 +7,184 @@
 
 #include "array_io.h"
 #include "array_op.h"
+#include "factor_cache.h"
+#include "inverse_op.h"
+#include "ldlt_op.h"
+#include "matrix_generators.h"
 #include "matrix_utils.h"
+#include "parallel_op.h"
 #include "timer.h"
+#include "tlr_op.h"
+
+// Decomposes the leading rows of the matrix, then appends the last
+// extend_count rows with cholesky_extend(); replaces the matrix storage.
+static int cholesky_by_extension(CholeskyMatrix* matrix, int extend_count, double* workspace) {
+  int n = matrix->size;
+  int base_size = n - extend_count;
+  CholeskyMatrix base = {base_size, matrix->block_size, NULL, NULL, NULL, 0};
+  double* border = (double*)malloc((size_t)extend_count * n * sizeof(double));
+  int status;
+
+  base.data = (double*)malloc(get_symmetric_matrix_size(base_size) * sizeof(double));
+  base.diagonal = (double*)malloc(base_size * sizeof(double));
+  if (!border || !base.data || !base.diagonal) {
+    status = -2;
+    goto cleanup;
+  }
+
+  for (int i = 0; i < base_size; ++i) {
+    memcpy(base.data + get_symmetric_index(i, i, base_size),
+           matrix->data + get_symmetric_index(i, i, n), (base_size - i) * sizeof(double));
+  }
+  for (int c = 0; c < extend_count; ++c) {
+    int row = base_size + c;
+    for (int i = 0; i < n; ++i) {
+      border[(size_t)c * n + i] = matrix->data[i < row ? get_symmetric_index(i, row, n)
+                                                       : get_symmetric_index(row, i, n)];
+    }
+  }
+
+  status = cholesky(&base, workspace);
+  if (status) goto cleanup;
+  print_time("on cholesky decomposition");
+
+  status = cholesky_extend(&base, extend_count, border, workspace);
+  if (status) goto cleanup;
+  printf("Extension: %d -> %d rows\n", base_size, n);
+  print_time("on extension");
+
+  free(matrix->data);
+  free(matrix->diagonal);
+  matrix->data = base.data;
+  matrix->diagonal = base.diagonal;
+  base.data = NULL;
+  base.diagonal = NULL;
+
+cleanup:
+  free(border);
+  free(base.data);
+  free(base.diagonal);
+  return status;
+}
+
+// Computes diag(A^{-1}) or A^{-1} from the factor and compares a few of its
+// columns with the triangular solves of unit vectors.
+static int check_inverse(const CholeskyMatrix* matrix, InverseMode mode) {
+  int n = matrix->size;
+  int samples[3] = {0, n / 2, n - 1};
+  double* inverse = (double*)malloc(get_symmetric_matrix_size(n) * sizeof(double));
+  double* diagonal = (double*)malloc(n * sizeof(double));
+  double* column = (double*)malloc(n * sizeof(double));
+  double* workspace =
+      (double*)malloc(get_inverse_workspace_size(matrix->block_size) * sizeof(double));
+  double trace = 0, deviation = 0;
+  int status = 0;
+
+  if (!inverse || !diagonal || !column || !workspace) {
+    status = -2;
+    goto cleanup;
+  }
+
+  if (mode == INVERSE_MODE_DIAGONAL) {
+    status = cholesky_inverse_diagonal(matrix, inverse, diagonal, workspace);
+  } else {
+    status = cholesky_selected_inverse(matrix, NULL, inverse, workspace);
+    for (int i = 0; i < n; ++i) diagonal[i] = inverse[get_symmetric_index(i, i, n)];
+  }
+  if (status) {
+    status = -13;
+    goto cleanup;
+  }
+  print_time("on inverse");
+
+  for (int i = 0; i < n; ++i) trace += diagonal[i];
+
+  for (int s = 0; s < 3; ++s) {
+    int c = samples[s];
+    double scale = 0;
+
+    memset(column, 0, n * sizeof(double));
+    column[c] = 1;
+    solve_lower_triangle_matrix_system(matrix, column);
+    solve_upper_triangle_matrix_diagonal_system(matrix, column);
+
+    for (int i = 0; i < n; ++i) scale = fmax(scale, fabs(column[i]));
+    if (mode == INVERSE_MODE_DIAGONAL) {
+      deviation = fmax(deviation, fabs(diagonal[c] - column[c]) / scale);
+    } else {
+      for (int i = 0; i < n; ++i) {
+        double value = inverse[i < c ? get_symmetric_index(i, c, n) : get_symmetric_index(c, i, n)];
+        deviation = fmax(deviation, fabs(value - column[i]) / scale);
+      }
+    }
+  }
+
+  printf("Inverse (%s): trace=%.10e ; max deviation from solves=%.3e\n",
+         mode == INVERSE_MODE_DIAGONAL ? "diagonal" : "full", trace, deviation);
+
+cleanup:
+  free(inverse);
+  free(diagonal);
+  free(column);
+  free(workspace);
+  return status;
+}
 
 int run_cholesky_solver(const SolverConfig* config, SolverResults* results) {
   int matrix_size = config->matrix_size;
   int block_size = config->block_size;
   int return_code = 0;
 
-  CholeskyMatrix matrix = {matrix_size, block_size, NULL, NULL};
+  CholeskyMatrix matrix = {matrix_size, block_size, NULL, NULL, NULL, 0};
   double* vector_answer = NULL;
   double* vector = NULL;
   double* exact_rhs = NULL;
   double* rhs = NULL;
   double* workspace = NULL;
+  size_t workspace_size = get_cholesky_workspace_size(block_size);
+  const MatrixGenerator* generator =
+      (config->generator ? config->generator : &matrix_generators[0]);
+  FactorCacheMapping cache_mapping = {NULL, 0};
+  TlrMatrix tlr_factor = {0, 0, 0, NULL, NULL, NULL};
+  FactorCacheKey cache_key = {0, 0};
 
   /* 1. Allocation */
-  matrix.data = (double*)malloc(get_symmetric_matrix_size(matrix_size) * sizeof(double));
+  // The TLR path streams the input by block rows and never stores it dense.
+  if (config->tlr_tolerance <= 0) {
+    matrix.data = (double*)malloc(get_symmetric_matrix_size(matrix_size) * sizeof(double));
+  }
   matrix.diagonal = (double*)malloc(matrix_size * sizeof(double));
   vector_answer = (double*)malloc(matrix_size * sizeof(double));
   vector = (double*)malloc(matrix_size * sizeof(double));
   exact_rhs = (double*)malloc(matrix_size * sizeof(double));
   rhs = (double*)malloc(matrix_size * sizeof(double));
-  workspace = (double*)malloc(3 * (size_t)block_size * block_size * sizeof(double));
+  if (config->mode == SOLVER_MODE_LDLT) {
+    size_t ldlt_workspace_size = get_ldlt_workspace_size(matrix_size, block_size);
+    if (ldlt_workspace_size > workspace_size) workspace_size = ldlt_workspace_size;
+    matrix.pivots = (int*)malloc(matrix_size * sizeof(int));
+  }
+  workspace = (double*)malloc(workspace_size * sizeof(double));
 
-  if (!matrix.data || !matrix.diagonal || !vector_answer || !vector || !exact_rhs || !rhs ||
-      !workspace) {
+  if ((config->tlr_tolerance <= 0 && !matrix.data) || !matrix.diagonal || !vector_answer || !vector || !exact_rhs || !rhs ||
+      !workspace || (config->mode == SOLVER_MODE_LDLT && !matrix.pivots)) {
     return_code = -2;
     goto cleanup;
   }
 
-  memset(matrix.data, 0, get_symmetric_matrix_size(matrix_size) * sizeof(double));
+  if (matrix.data) memset(matrix.data, 0, get_symmetric_matrix_size(matrix_size) * sizeof(double));
   memset(matrix.diagonal, 0, matrix_size * sizeof(double));
   memset(vector_answer, 0, matrix_size * sizeof(double));
   memset(vector, 0, matrix_size * sizeof(double));
   memset(exact_rhs, 0, matrix_size * sizeof(double));
   memset(rhs, 0, matrix_size * sizeof(double));
-  memset(workspace, 0, 3 * (size_t)block_size * block_size * sizeof(double));
+  memset(workspace, 0, workspace_size * sizeof(double));
 
   /* 2. Initialization */
   fill_vector_answer(matrix_size, vector_answer);
 
   if (config->input_file == NULL) {
-    if (fill_matrix(&matrix, vector_answer, rhs)) {
+    if (generate_matrix(&matrix, generator, config->seed, config->thread_count, vector_answer,
+                        rhs)) {
       return_code = -3;
       goto cleanup;
     }
@@ -60,6 +195,8 @@ int run_cholesky_solver(const SolverConfig* config, SolverResults* results) {
     }
   }
 
+  if (config->cache_dir) cache_key = factor_cache_key(&matrix);
+
   for (int i = 0; i < matrix_size; i++) {
     exact_rhs[i] = rhs[i];
     vector[i] = rhs[i];
@@ -68,31 +205,158 @@ int run_cholesky_solver(const SolverConfig* config, SolverResults* results) {
   print_time("on initialization");
 
   if (matrix_size < 15) {
-    printf("matrix A:\n");
-    printf_matrix(&matrix);
+    if (matrix.data) {
+      printf("matrix A:\n");
+      printf_matrix(&matrix);
+    }
     printf("\nrhs:\n");
     for (int i = 0; i < matrix_size; ++i) printf("%.10f ", rhs[i]);
     printf("\n\n");
   }
 
   /* 3. Algorithm Execution */
-  if (cholesky(&matrix, workspace)) {
-    return_code = -10;
-    goto cleanup;
+  if (config->cache_dir) {
+    double* input_data = matrix.data;
+    double* input_diagonal = matrix.diagonal;
+    int* input_pivots = matrix.pivots;
+
+    if (factor_cache_load(config->cache_dir, cache_key, &matrix, &cache_mapping) == 0) {
+      free(input_data);
+      free(input_diagonal);
+      if (input_pivots) free(input_pivots);
+      printf("Factor cache: hit (%016llx)\n", (unsigned long long)cache_key.key);
+      print_time("on factor cache load");
+    }
   }
-  print_time("on cholesky decomposition");
 
-  if (solve_lower_triangle_matrix_system(&matrix, vector, workspace)) {
-    return_code = -11;
-    goto cleanup;
+  if (config->tlr_tolerance > 0) {
+    TlrStats stats;
+    GeneratedMatrixRows generated_rows = {generator, matrix_size, config->seed};
+    MatrixFileRows file_rows = {NULL, matrix_size, 0};
+    int status;
+
+    if (config->input_file == NULL) {
+      status = tlr_cholesky(matrix_size, block_size, generate_matrix_rows, &generated_rows,
+                            config->tlr_tolerance, &tlr_factor);
+    } else {
+      if (open_matrix_rows(&file_rows, matrix_size, config->input_file)) {
+        return_code = -4;
+        goto cleanup;
+      }
+      status = tlr_cholesky(matrix_size, block_size, read_matrix_rows, &file_rows,
+                            config->tlr_tolerance, &tlr_factor);
+      close_matrix_rows(&file_rows);
+    }
+    if (status) {
+      return_code = (status == -2 ? -2 : (status == -3 ? -4 : -10));
+      goto cleanup;
+    }
+    print_time("on tlr decomposition");
+
+    get_tlr_stats(&tlr_factor, &stats);
+    printf("TLR factor: %.2f MiB compressed vs %.2f MiB dense, both as packed triangles "
+           "(%.1f%%) ; "
+           "low-rank tiles %d/%d ; max rank %d\n",
+           stats.compressed_bytes / 1048576.0, stats.dense_bytes / 1048576.0,
+           100.0 * stats.compressed_bytes / stats.dense_bytes, stats.low_rank_tiles,
+           stats.low_rank_tiles + stats.dense_tiles, stats.max_rank);
+  } else if (!cache_mapping.base) {
+    if (config->mode == SOLVER_MODE_LDLT) {
+      if (ldlt(&matrix, workspace)) {
+        return_code = -10;
+        goto cleanup;
+      }
+      print_time("on ldlt decomposition");
+    } else if (config->extend_count > 0) {
+      int status = cholesky_by_extension(&matrix, config->extend_count, workspace);
+      if (status) {
+        return_code = (status == -2 ? -2 : -10);
+        goto cleanup;
+      }
+    } else if (config->split_row > 0) {
+      int schur_size = matrix_size - config->split_row;
+      double trace = 0;
+
+      if (cholesky_partial(&matrix, config->split_row, workspace)) {
+        return_code = -10;
+        goto cleanup;
+      }
+
+      const double* schur = get_schur_complement(&matrix, config->split_row);
+      for (int i = 0; i < schur_size; ++i) trace += schur[get_symmetric_index(i, i, schur_size)];
+      printf("Schur complement: size=%d ; trace=%.10e\n", schur_size, trace);
+      print_time("on partial decomposition");
+
+      if (cholesky_resume(&matrix, config->split_row, workspace)) {
+        return_code = -10;
+        goto cleanup;
+      }
+      print_time("on cholesky decomposition");
+    } else {
+      set_cholesky_profiling(config->profile);
+      int status = (config->thread_count > 1
+                        ? cholesky_parallel(&matrix, config->thread_count, config->reduction)
+                        : cholesky(&matrix, workspace));
+      if (status) {
+        return_code = (status == -2 ? -2 : -10);
+        goto cleanup;
+      }
+      print_time("on cholesky decomposition");
+
+      if (config->profile) {
+        CholeskyProfile profile;
+        get_cholesky_profile(&profile);
+        printf("Profile: exposed pack=%.3fs ; update (incl. overlapped gathers)=%.3fs ; "
+               "factor=%.3fs\n",
+               profile.pack_seconds, profile.update_seconds, profile.factor_seconds);
+      }
+    }
+
+    if (config->cache_dir) {
+      if (factor_cache_store(config->cache_dir, cache_key, &matrix, config->cache_max_bytes))
+        printf("Warning: cannot store factor in cache directory '%s'\n", config->cache_dir);
+      else
+        printf("Factor cache: stored (%016llx)\n", (unsigned long long)cache_key.key);
+      print_time("on factor cache store");
+    }
   }
 
-  if (solve_upper_triangle_matrix_diagonal_system(&matrix, vector, workspace)) {
-    return_code = -12;
-    goto cleanup;
+  if (config->tlr_tolerance > 0) {
+    if (solve_tlr_system(&tlr_factor, vector)) {
+      return_code = -11;
+      goto cleanup;
+    }
+  } else if (config->mode == SOLVER_MODE_LDLT) {
+    if (solve_ldlt_system(&matrix, vector)) {
+      return_code = -11;
+      goto cleanup;
+    }
+  } else {
+    if (solve_lower_triangle_matrix_system(&matrix, vector)) {
+      return_code = -11;
+      goto cleanup;
+    }
+
+    if (solve_upper_triangle_matrix_diagonal_system(&matrix, vector)) {
+      return_code = -12;
+      goto cleanup;
+    }
   }
 
-  if (matrix_size < 15) {
+  if (config->inverse_mode != INVERSE_MODE_NONE) {
+    return_code = check_inverse(&matrix, config->inverse_mode);
+    if (return_code) goto cleanup;
+  }
+
+  if (config->print_hashes) {
+    printf("Hashes: R=%016llx ; D=%016llx ; x=%016llx\n",
+           (unsigned long long)hash_doubles(matrix.data, get_symmetric_matrix_size(matrix_size)),
+           (unsigned long long)hash_doubles(matrix.diagonal, matrix_size),
+           (unsigned long long)hash_doubles(vector, matrix_size));
+  }
+
+  // The TLR factor is not stored in the matrix.
+  if (matrix_size < 15 && config->tlr_tolerance <= 0) {
     printf("cholesky decomposition:\n");
     printf_matrix(&matrix);
     printf("\ndiagonal:\n");
@@ -104,9 +368,9 @@ int run_cholesky_solver(const SolverConfig* config, SolverResults* results) {
   /* 4. Verification */
   double residual = 0, rhs_norm = 0, answer_error = 0;
 
-  // Re-generate/read matrix to verify residual
+  // Re-generate/read matrix to verify residual (without storing it on the TLR path)
   if (config->input_file == NULL) {
-    fill_matrix(&matrix, vector, rhs);
+    generate_matrix(&matrix, generator, config->seed, config->thread_count, vector, rhs);
   } else {
     read_matrix(&matrix, vector, rhs, config->input_file);
   }
@@ -129,13 +393,19 @@ int run_cholesky_solver(const SolverConfig* config, SolverResults* results) {
   }
 
 cleanup:
-  if (matrix.data) free(matrix.data);
-  if (matrix.diagonal) free(matrix.diagonal);
+  if (cache_mapping.base) {
+    factor_cache_release(&cache_mapping);
+  } else {
+    if (matrix.data) free(matrix.data);
+    if (matrix.diagonal) free(matrix.diagonal);
+    if (matrix.pivots) free(matrix.pivots);
+  }
   if (vector_answer) free(vector_answer);
   if (vector) free(vector);
   if (exact_rhs) free(exact_rhs);
   if (rhs) free(rhs);
   if (workspace) free(workspace);
+  free_tlr_matrix(&tlr_factor);
 
   return return_code;
 }
@@ -1,13 +1,47 @@
 #ifndef SOLVER_ENGINE_H
 #define SOLVER_ENGINE_H
 
+#include <stdint.h>
+
+#include "matrix_generators.h"
 #include "matrix_utils.h"
+#include "parallel_op.h"
+
+// Decomposition used by the solver.
+typedef enum {
+  SOLVER_MODE_CHOLESKY,  // Block R^T D R decomposition (D = +-1), no pivoting.
+  SOLVER_MODE_LDLT,      // Blocked L D L^T with Bunch-Kaufman pivoting for indefinite systems.
+} SolverMode;
+
+// Part of A^{-1} computed from the factor after the solve.
+typedef enum {
+  INVERSE_MODE_NONE,
+  INVERSE_MODE_DIAGONAL,  // diag(A^{-1}) only.
+  INVERSE_MODE_FULL,      // The whole packed A^{-1}.
+} InverseMode;
 
 // Configuration for the Cholesky solver execution.
 typedef struct {
-  int matrix_size;         // Total dimension of the symmetric matrix.
-  int block_size;          // Size of square blocks for cache optimization.
-  const char* input_file;  // Optional file path to read matrix from (NULL for auto-fill).
+  int matrix_size;          // Total dimension of the symmetric matrix.
+  int block_size;           // Size of square blocks for cache optimization.
+  const char* input_file;   // Optional file path to read matrix from (NULL for auto-fill).
+  const char* cache_dir;    // Optional factor cache directory (NULL disables caching).
+  size_t cache_max_bytes;   // Size cap of the factor cache directory.
+  SolverMode mode;          // Decomposition to use.
+  int thread_count;         // Threads of the Cholesky decomposition and generator.
+  ReductionMode reduction;  // Reduction order of the parallel trailing updates.
+  int print_hashes;         // Print hashes of R, D and x to compare runs bit for bit.
+  // Matrix family used when there is no input file (NULL for the default).
+  const MatrixGenerator* generator;
+  uint64_t seed;  // Seed of the randomized matrix families.
+  // Eliminate this many rows first, then resume from the Schur complement (0 = off).
+  int split_row;
+  // Factor all but this many trailing rows, then append them with cholesky_extend() (0 = off).
+  int extend_count;
+  // Relative tolerance of the tile low-rank factorization (0 = dense factor).
+  double tlr_tolerance;
+  InverseMode inverse_mode;  // Inverse computed from the factor and checked against solves.
+  int profile;               // Print the pack/update/factor time split of the decomposition.
 } SolverConfig;
 
 // Results and metrics from the solver execution.
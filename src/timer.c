@@ -13,6 +13,7 @@ typedef struct {
 static struct timespec start_ts;
 static struct timespec prev_ts;
 static int timer_active = 0;
+static int stage_lines = 0;
 
 static double get_elapsed_seconds(struct timespec start, struct timespec end) {
   return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
@@ -34,6 +35,10 @@ void timer_start(void) {
   timer_active = 1;
 }
 
+void timer_print_stages(int enabled) {
+  stage_lines = enabled;
+}
+
 void print_time(const char* message) {
   struct timespec current_ts;
   clock_gettime(CLOCK_MONOTONIC, &current_ts);
@@ -51,6 +56,13 @@ void print_time(const char* message) {
          total_tc.min, total_tc.sec, total_tc.tic, message, stage_tc.hour, stage_tc.min,
          stage_tc.sec, stage_tc.tic);
 
+  // Full clock resolution for tools that compare stage times (benchmarks/manager.py).
+  if (stage_lines) {
+    long long stage_ns = (long long)(current_ts.tv_sec - prev_ts.tv_sec) * 1000000000LL +
+                         (current_ts.tv_nsec - prev_ts.tv_nsec);
+    printf("Stage: %s ns=%lld\n", message, stage_ns);
+  }
+
   prev_ts = current_ts;
 }
 
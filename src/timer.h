@@ -3,6 +3,9 @@
 
 /* Запустить таймер */
 void timer_start(void);
+/* Печатать после каждой строки print_time строку "Stage: MESSAGE ns=N" с временем
+   этапа в наносекундах (ENABLED != 0) */
+void timer_print_stages(int enabled);
 /* Напечатать время от старта и от последнего вызова с заголовком MESSAGE */
 void print_time(const char* message);
 /* Напечатать время от старта и от последнего вызова с заголовком MESSAGE */
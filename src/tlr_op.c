@@ -0,0 +1,392 @@
+#include "tlr_op.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_kernels.h"
+#include "matrix_utils.h"
+
+// Scratch blocks used while factoring (each block_size^2 doubles).
+enum {
+  TLR_TILE,        // Tile being updated.
+  TLR_INVERSE,     // Inverse of the current diagonal block (with D).
+  TLR_CORE,        // U_a^T D U_b of an update.
+  TLR_EXPANDED,    // Vt_a^T times the core.
+  TLR_SCALED,      // Scaled off-diagonal tile before compression.
+  TLR_RESIDUAL,    // Compression: columns of the tile still to be approximated.
+  TLR_BASIS,       // Compression: orthonormal basis (U, column by column).
+  TLR_COEFFICIENTS,  // Compression: coefficients (Vt).
+  TLR_SCRATCH_BLOCKS
+};
+
+// Computes C = C + A * B with A of size m x n and B of size n x l.
+static void block_multiply_add(int m, int n, int l, const double* a, const double* b, double* c) {
+  int i, k, j;
+
+  for (i = 0; i < m; ++i) {
+    double* pc = c + (size_t)i * l;
+    for (k = 0; k < n; ++k) {
+      double ta = a[(size_t)i * n + k];
+      const double* pb = b + (size_t)k * l;
+
+      for (j = 0; j < l - 7; j += 8) {
+        pc[j] += pb[j] * ta;
+        pc[j + 1] += pb[j + 1] * ta;
+        pc[j + 2] += pb[j + 2] * ta;
+        pc[j + 3] += pb[j + 3] * ta;
+        pc[j + 4] += pb[j + 4] * ta;
+        pc[j + 5] += pb[j + 5] * ta;
+        pc[j + 6] += pb[j + 6] * ta;
+        pc[j + 7] += pb[j + 7] * ta;
+      }
+
+      for (; j < l; ++j) pc[j] += pb[j] * ta;
+    }
+  }
+}
+
+// Applies C = C - R_a^T D R_b for the tiles R_a = R(k, i) and R_b = R(k, j).
+//
+// The inner product over the k rows only involves the left factors:
+// M = U_a^T D U_b is rank_a x rank_b (a dense tile is its own left factor),
+// after which C -= Vt_a^T M Vt_b costs rows * columns * rank.
+static void apply_tile_update(const TlrTile* a, const TlrTile* b, const double* d, double* c,
+                              double* scratch, size_t block_elements) {
+  int rows = a->columns, columns = b->columns, k_rows = a->rows;
+  int left_a = (a->rank == TLR_DENSE_TILE ? rows : a->rank);
+  int left_b = (b->rank == TLR_DENSE_TILE ? columns : b->rank);
+  double* core = scratch + TLR_CORE * block_elements;
+  double* expanded = scratch + TLR_EXPANDED * block_elements;
+  int i;
+
+  if (left_a == 0 || left_b == 0) return;
+
+  // core = -U_a^T D U_b.
+  memset(core, 0, (size_t)left_a * left_b * sizeof(double));
+  main_blocks_diagonal_multiply(k_rows, left_a, left_b, a->u, b->u, d, core, NULL);
+
+  // expanded = Vt_a^T core (rows x left_b).
+  if (a->rank != TLR_DENSE_TILE)
+    main_blocks_multiply(a->rank, rows, left_b, a->vt, core, expanded);
+  else
+    expanded = core;
+
+  if (b->rank != TLR_DENSE_TILE) {
+    block_multiply_add(rows, b->rank, columns, expanded, b->vt, c);
+  } else {
+    for (i = 0; i < rows * columns; ++i) c[i] += expanded[i];
+  }
+}
+
+// Compresses the rows x columns tile c into U * Vt with a column-pivoted
+// modified Gram-Schmidt; keeps it dense if the factors would not be smaller.
+static int compress_tile(int rows, int columns, const double* c, double tolerance,
+                         TlrTile* tile, double* scratch, size_t block_elements) {
+  double* residual = scratch + TLR_RESIDUAL * block_elements;  // Column-major copy of c.
+  double* basis = scratch + TLR_BASIS * block_elements;
+  double* coefficients = scratch + TLR_COEFFICIENTS * block_elements;
+  int max_rank = rows * columns / (rows + columns);
+  double tile_norm = 0, residual_norm;
+  int i, j, t, rank = 0;
+
+  tile->rows = rows;
+  tile->columns = columns;
+
+  for (i = 0; i < rows; ++i) {
+    for (j = 0; j < columns; ++j) {
+      residual[(size_t)j * rows + i] = c[(size_t)i * columns + j];
+      tile_norm += c[(size_t)i * columns + j] * c[(size_t)i * columns + j];
+    }
+  }
+
+  for (;;) {
+    int pivot = 0;
+    double pivot_norm = -1;
+
+    residual_norm = 0;
+    for (j = 0; j < columns; ++j) {
+      double norm = 0;
+      const double* column = residual + (size_t)j * rows;
+      for (i = 0; i < rows; ++i) norm += column[i] * column[i];
+      residual_norm += norm;
+      if (norm > pivot_norm) {
+        pivot_norm = norm;
+        pivot = j;
+      }
+    }
+
+    if (residual_norm <= tolerance * tolerance * tile_norm || pivot_norm <= 0) break;
+    if (rank == max_rank) {
+      rank = TLR_DENSE_TILE;
+      break;
+    }
+
+    // Next basis vector: the normalized residual column with the largest norm.
+    double* q = basis + (size_t)rank * rows;
+    double scale = 1.0 / sqrt(pivot_norm);
+    for (i = 0; i < rows; ++i) q[i] = residual[(size_t)pivot * rows + i] * scale;
+
+    for (j = 0; j < columns; ++j) {
+      double* column = residual + (size_t)j * rows;
+      double projection = 0;
+      for (i = 0; i < rows; ++i) projection += q[i] * column[i];
+      for (i = 0; i < rows; ++i) column[i] -= projection * q[i];
+      coefficients[(size_t)rank * columns + j] = projection;
+    }
+    rank++;
+  }
+
+  tile->rank = rank;
+  if (rank == TLR_DENSE_TILE) {
+    tile->u = (double*)malloc((size_t)rows * columns * sizeof(double));
+    tile->vt = NULL;
+    if (!tile->u) return -2;
+    memcpy(tile->u, c, (size_t)rows * columns * sizeof(double));
+    return 0;
+  }
+
+  if (rank == 0) {
+    tile->u = NULL;
+    tile->vt = NULL;
+    return 0;
+  }
+
+  tile->u = (double*)malloc((size_t)rows * rank * sizeof(double));
+  tile->vt = (double*)malloc((size_t)rank * columns * sizeof(double));
+  if (!tile->u || !tile->vt) return -2;
+
+  for (i = 0; i < rows; ++i) {
+    for (t = 0; t < rank; ++t) tile->u[(size_t)i * rank + t] = basis[(size_t)t * rows + i];
+  }
+  memcpy(tile->vt, coefficients, (size_t)rank * columns * sizeof(double));
+  return 0;
+}
+
+int tlr_cholesky(int n, int block_size, TlrRowSource source, void* context, double tolerance,
+                 TlrMatrix* factor) {
+  int block_count = (n + block_size - 1) / block_size;
+  size_t block_elements = (size_t)block_size * block_size;
+  size_t tile_count = (size_t)block_count * (block_count - 1) / 2;
+  double *scratch, *block_rows, *c, *inverse, *scaled;
+  int bi, bj, bk, r, return_code = 0;
+
+  memset(factor, 0, sizeof(*factor));
+  factor->size = n;
+  factor->block_size = block_size;
+  factor->block_count = block_count;
+  factor->diagonal_blocks = (double*)calloc(block_count * block_elements, sizeof(double));
+  factor->diagonal = (double*)calloc(n, sizeof(double));
+  factor->tiles = (TlrTile*)calloc(tile_count ? tile_count : 1, sizeof(TlrTile));
+  scratch = (double*)malloc(TLR_SCRATCH_BLOCKS * block_elements * sizeof(double));
+  // The only dense copy of the input: one block row at a time.
+  block_rows = (double*)malloc((size_t)block_size * n * sizeof(double));
+  if (!factor->diagonal_blocks || !factor->diagonal || !factor->tiles || !scratch ||
+      !block_rows) {
+    free(scratch);
+    free(block_rows);
+    free_tlr_matrix(factor);
+    return -2;
+  }
+  c = scratch + TLR_TILE * block_elements;
+  inverse = scratch + TLR_INVERSE * block_elements;
+  scaled = scratch + TLR_SCALED * block_elements;
+
+  for (bi = 0; bi < block_count && return_code == 0; ++bi) {
+    int i = bi * block_size;
+    int rows = (i + block_size < n ? block_size : n - i);
+    int width = n - i;
+    double* diagonal_block = factor->diagonal_blocks + bi * block_elements;
+
+    if (source(context, i, rows, block_rows)) {
+      return_code = -3;
+      break;
+    }
+
+    // Diagonal block: A_ii - sum_k R_ki^T D_k R_ki, then its dense factorization.
+    memset(c, 0, (size_t)rows * rows * sizeof(double));
+    for (r = 0; r < rows; ++r) {
+      memcpy(c + (size_t)r * rows + r, block_rows + (size_t)r * width + r,
+             (rows - r) * sizeof(double));
+    }
+    for (bk = 0; bk < bi; ++bk) {
+      const TlrTile* tile = &factor->tiles[get_tlr_tile_index(bk, bi, block_count)];
+      apply_tile_update(tile, tile, factor->diagonal + bk * block_size, c, scratch,
+                        block_elements);
+    }
+
+    if (cholesky_for_block(rows, c, factor->diagonal + i) ||
+        inverse_upper_triangle_block_and_diagonal(rows, c, factor->diagonal + i, inverse)) {
+      return_code = -1;
+      break;
+    }
+    memcpy(diagonal_block, c, (size_t)rows * rows * sizeof(double));
+
+    // Off-diagonal tiles: update, scale by the inverse of the diagonal block, compress.
+    for (bj = bi + 1; bj < block_count; ++bj) {
+      int j = bj * block_size;
+      int columns = (j + block_size < n ? block_size : n - j);
+      TlrTile* tile = &factor->tiles[get_tlr_tile_index(bi, bj, block_count)];
+
+      for (r = 0; r < rows; ++r) {
+        memcpy(c + (size_t)r * columns, block_rows + (size_t)r * width + (j - i),
+               columns * sizeof(double));
+      }
+      for (bk = 0; bk < bi; ++bk) {
+        apply_tile_update(&factor->tiles[get_tlr_tile_index(bk, bi, block_count)],
+                          &factor->tiles[get_tlr_tile_index(bk, bj, block_count)],
+                          factor->diagonal + bk * block_size, c, scratch, block_elements);
+      }
+
+      main_blocks_multiply(rows, rows, columns, inverse, c, scaled);
+      if (compress_tile(rows, columns, scaled, tolerance, tile, scratch, block_elements)) {
+        return_code = -2;
+        break;
+      }
+    }
+  }
+
+  free(scratch);
+  free(block_rows);
+  if (return_code) free_tlr_matrix(factor);
+  return return_code;
+}
+
+int solve_tlr_system(const TlrMatrix* factor, double* rhs) {
+  int n = factor->size;
+  int block_size = factor->block_size;
+  int block_count = factor->block_count;
+  size_t block_elements = (size_t)block_size * block_size;
+  double* w;  // U^T y_i or Vt x_j; the rank of a tile is below the block size.
+  int bi, bj, r, c, t;
+  int return_code = 0;
+
+  w = (double*)malloc((block_size > 0 ? block_size : 1) * sizeof(double));
+  if (!w) return -2;
+
+  // Forward sweep R^T y = b.
+  for (bi = 0; bi < block_count; ++bi) {
+    int i = bi * block_size;
+    int rows = (i + block_size < n ? block_size : n - i);
+    const double* diagonal_block = factor->diagonal_blocks + bi * block_elements;
+    double* y = rhs + i;
+
+    for (r = 0; r < rows; ++r) {
+      if (fabs(diagonal_block[r * rows + r]) < EPS) {
+        return_code = -1;
+        goto cleanup;
+      }
+      y[r] /= diagonal_block[r * rows + r];
+      for (c = r + 1; c < rows; ++c) y[c] -= diagonal_block[r * rows + c] * y[r];
+    }
+
+    // b_j -= R_ij^T y_i = Vt^T (U^T y_i).
+    for (bj = bi + 1; bj < block_count; ++bj) {
+      const TlrTile* tile = &factor->tiles[get_tlr_tile_index(bi, bj, block_count)];
+      double* b = rhs + bj * block_size;
+
+      if (tile->rank == TLR_DENSE_TILE) {
+        for (r = 0; r < rows; ++r) {
+          for (c = 0; c < tile->columns; ++c) b[c] -= tile->u[r * tile->columns + c] * y[r];
+        }
+        continue;
+      }
+
+      for (t = 0; t < tile->rank; ++t) w[t] = 0;
+      for (r = 0; r < rows; ++r) {
+        for (t = 0; t < tile->rank; ++t) w[t] += tile->u[r * tile->rank + t] * y[r];
+      }
+      for (t = 0; t < tile->rank; ++t) {
+        for (c = 0; c < tile->columns; ++c) b[c] -= tile->vt[t * tile->columns + c] * w[t];
+      }
+    }
+  }
+
+  // Backward sweep D R x = y: R_ii x_i = D_i y_i - sum_j R_ij x_j.
+  for (bi = block_count - 1; bi >= 0; --bi) {
+    int i = bi * block_size;
+    int rows = (i + block_size < n ? block_size : n - i);
+    const double* diagonal_block = factor->diagonal_blocks + bi * block_elements;
+    double* x = rhs + i;
+
+    for (r = 0; r < rows; ++r) x[r] *= factor->diagonal[i + r];
+
+    // x_i -= R_ij x_j = U (Vt x_j).
+    for (bj = bi + 1; bj < block_count; ++bj) {
+      const TlrTile* tile = &factor->tiles[get_tlr_tile_index(bi, bj, block_count)];
+      const double* xj = rhs + bj * block_size;
+
+      if (tile->rank == TLR_DENSE_TILE) {
+        for (r = 0; r < rows; ++r) {
+          for (c = 0; c < tile->columns; ++c) x[r] -= tile->u[r * tile->columns + c] * xj[c];
+        }
+        continue;
+      }
+
+      for (t = 0; t < tile->rank; ++t) {
+        w[t] = 0;
+        for (c = 0; c < tile->columns; ++c) w[t] += tile->vt[t * tile->columns + c] * xj[c];
+      }
+      for (r = 0; r < rows; ++r) {
+        for (t = 0; t < tile->rank; ++t) x[r] -= tile->u[r * tile->rank + t] * w[t];
+      }
+    }
+
+    for (r = rows - 1; r >= 0; --r) {
+      for (c = r + 1; c < rows; ++c) x[r] -= diagonal_block[r * rows + c] * x[c];
+      x[r] /= diagonal_block[r * rows + r];
+    }
+  }
+
+cleanup:
+  free(w);
+  return return_code;
+}
+
+void get_tlr_stats(const TlrMatrix* factor, TlrStats* stats) {
+  int n = factor->size;
+  int block_size = factor->block_size;
+  int block_count = factor->block_count;
+  size_t tile_count = (size_t)block_count * (block_count - 1) / 2;
+  size_t t;
+  int bi;
+
+  memset(stats, 0, sizeof(*stats));
+  stats->dense_bytes = (get_symmetric_matrix_size(n) + n) * sizeof(double);
+
+  // Each R_ii is held in a full square but only its upper triangle carries
+  // data; count it like the packed dense storage does.
+  stats->compressed_bytes = n * sizeof(double);
+  for (bi = 0; bi < block_count; ++bi) {
+    int rows = (bi * block_size + block_size < n ? block_size : n - bi * block_size);
+    stats->compressed_bytes += get_symmetric_matrix_size(rows) * sizeof(double);
+  }
+
+  for (t = 0; t < tile_count; ++t) {
+    const TlrTile* tile = &factor->tiles[t];
+    if (tile->rank == TLR_DENSE_TILE) {
+      stats->dense_tiles++;
+      stats->compressed_bytes += (size_t)tile->rows * tile->columns * sizeof(double);
+    } else {
+      stats->low_rank_tiles++;
+      stats->compressed_bytes += (size_t)tile->rank * (tile->rows + tile->columns) * sizeof(double);
+      if (tile->rank > stats->max_rank) stats->max_rank = tile->rank;
+    }
+  }
+}
+
+void free_tlr_matrix(TlrMatrix* factor) {
+  size_t tile_count = (size_t)factor->block_count * (factor->block_count - 1) / 2;
+  size_t t;
+
+  if (factor->tiles) {
+    for (t = 0; t < tile_count; ++t) {
+      free(factor->tiles[t].u);
+      free(factor->tiles[t].vt);
+    }
+  }
+  free(factor->tiles);
+  free(factor->diagonal_blocks);
+  free(factor->diagonal);
+  memset(factor, 0, sizeof(*factor));
+}
@@ -0,0 +1,107 @@
+#ifndef TLR_OP_H
+#define TLR_OP_H
+
+#include <stddef.h>
+
+#include "matrix_utils.h"
+
+// Rank of an off-diagonal tile that is kept dense.
+#define TLR_DENSE_TILE (-1)
+
+// An off-diagonal tile R_ij of the factor, either U * Vt or dense.
+typedef struct {
+  int rows;
+  int columns;
+  int rank;    // Rank of the approximation, or TLR_DENSE_TILE.
+  double* u;   // rows x rank (or the dense rows x columns tile).
+  double* vt;  // rank x columns (NULL for a dense tile).
+} TlrTile;
+
+// Tile low-rank R^T D R factor: dense diagonal blocks, compressed off-diagonal tiles.
+typedef struct {
+  int size;
+  int block_size;
+  int block_count;
+  double* diagonal_blocks;  // block_count dense blocks of block_size^2 doubles holding R_ii.
+  double* diagonal;         // D.
+  TlrTile* tiles;           // Off-diagonal tiles (i < j), row by row (see get_tlr_tile_index()).
+} TlrMatrix;
+
+// Storage summary of a TLR factor.
+typedef struct {
+  // Upper triangles of the diagonal blocks, D and all tiles as stored.
+  size_t compressed_bytes;
+  size_t dense_bytes;  // The same factor in packed dense storage (upper triangle and D).
+  int low_rank_tiles;
+  int dense_tiles;
+  int max_rank;
+} TlrStats;
+
+// Supplies the input rows [row, row + count) of a symmetric n x n matrix to
+// tlr_cholesky(). Rows are requested once each, in increasing order, so a
+// source can generate or read them on demand. Row row + r goes to
+// rows + r * (n - row) as its columns [row, n); the entries left of its
+// diagonal are not read.
+//
+// Returns:
+//   0 on success, non-zero if the rows cannot be produced.
+typedef int (*TlrRowSource)(void* context, int row, int count, double* rows);
+
+// Returns the position of the off-diagonal tile (block_row, block_column),
+// block_row < block_column, in TlrMatrix::tiles.
+static inline size_t get_tlr_tile_index(int block_row, int block_column, int block_count) {
+  return (size_t)block_row * block_count - (size_t)block_row * (block_row + 1) / 2 +
+         (block_column - block_row - 1);
+}
+
+// Performs the block decomposition A = R^T D R with compressed off-diagonal tiles.
+//
+// Every off-diagonal tile of R is approximated by U * Vt, with the rank chosen
+// by a column-pivoted Gram-Schmidt so that the Frobenius norm of the error is
+// at most tolerance times the norm of the tile. Tiles that would not get
+// smaller are kept dense. The trailing updates run on the compressed form:
+// R_ki^T D_k R_kj = Vt_a^T (U_a^T D_k U_b) Vt_b.
+//
+// The factorization is left-looking: block row i only needs A's block row i
+// and the compressed rows above it. The input is pulled from source one block
+// row at a time and compressed right away, so besides the factor only
+// block_size x n doubles of it are ever held.
+//
+// Args:
+//   n: Matrix size.
+//   block_size: Tile size.
+//   source: Supplier of the input block rows.
+//   context: Passed to source.
+//   tolerance: Relative compression tolerance of the off-diagonal tiles.
+//   factor: Output factor; release it with free_tlr_matrix().
+//
+// Returns:
+//   0 on success, -1 if the matrix is singular, -2 if memory could not be
+//   allocated, -3 if source failed.
+int tlr_cholesky(int n, int block_size, TlrRowSource source, void* context, double tolerance,
+                 TlrMatrix* factor);
+
+// Solves A x = b with a TLR factor (R^T y = b, then D R x = y).
+//
+// Args:
+//   factor: Factor computed by tlr_cholesky().
+//   rhs: The right-hand side vector (modified in-place to the solution).
+//
+// Returns:
+//   0 on success, -1 if R is singular, -2 if memory could not be allocated.
+int solve_tlr_system(const TlrMatrix* factor, double* rhs);
+
+// Computes the storage summary of a TLR factor.
+//
+// Args:
+//   factor: Factor computed by tlr_cholesky().
+//   stats: Output summary.
+void get_tlr_stats(const TlrMatrix* factor, TlrStats* stats);
+
+// Releases the memory held by a TLR factor.
+//
+// Args:
+//   factor: Factor computed by tlr_cholesky() (may be partially built).
+void free_tlr_matrix(TlrMatrix* factor);
+
+#endif
@@ -0,0 +1,68 @@
+#!/bin/bash
+
+# Reproducibility tests for the parallel Cholesky decomposition
+#
+# Usage: tests/reproducibility_tests.sh [max_threads]
+#
+# The ordered reduction must produce bitwise identical R, D and x for every
+# thread count (compared through the hashes printed by --print-hashes). The
+# cost of the fixed order is reported against the unordered reduction.
+
+EXE="./build/cholesky_solver"
+MAX_THREADS=${1:-8}
+SIZES="257:1 500:16 1000:32 1000:64"
+
+# Ensure the project is built
+make -C src
+
+echo "Running reproducibility tests..."
+
+get_hashes() {
+  $EXE --print-hashes "$@" 2>/dev/null | grep "^Hashes:"
+}
+
+get_decomposition_seconds() {
+  $EXE "$@" 2>/dev/null | sed -n 's/.*on cholesky decomposition=\([0-9:.]*\).*/\1/p' |
+    awk -F: '{ print $1 * 3600 + $2 * 60 + $3 }'
+}
+
+# Test 1: Ordered reduction is bitwise identical across thread counts and to the serial code
+for case in $SIZES; do
+  n=${case%%:*}
+  bs=${case##*:}
+  reference=$(get_hashes $n $bs)
+  result="PASS"
+  for threads in $(seq 2 $MAX_THREADS); do
+    for run in 1 2; do
+      if [ "$(get_hashes --threads=$threads $n $bs)" != "$reference" ]; then
+        result="FAIL (threads=$threads, run $run)"
+      fi
+    done
+  done
+  echo "Test 1 (Ordered hashes n=$n bs=$bs, threads 1..$MAX_THREADS): $result"
+done
+
+# Test 2: Ordered reduction is also reproducible for input files
+printf "4 1 0\n5 2\n6\n" > reproducibility_input.txt
+echo -n "Test 2 (Ordered hashes for file input): "
+reference=$(get_hashes 3 1 reproducibility_input.txt)
+result="PASS"
+for threads in $(seq 2 $MAX_THREADS); do
+  [ "$(get_hashes --threads=$threads 3 1 reproducibility_input.txt)" != "$reference" ] &&
+    result="FAIL (threads=$threads)"
+done
+echo "$result"
+
+# Report: overhead of the ordered reduction against the unordered one
+echo "Reproducibility overhead (decomposition seconds, ordered vs unordered):"
+for threads in $(seq 2 $MAX_THREADS); do
+  ordered=$(get_decomposition_seconds --threads=$threads 2000 64)
+  unordered=$(get_decomposition_seconds --threads=$threads --reduction=unordered 2000 64)
+  awk -v t=$threads -v o=$ordered -v u=$unordered 'BEGIN {
+    printf "  threads=%d ordered=%.2fs unordered=%.2fs overhead=%+.1f%%\n", t, o, u,
+           (u > 0 ? 100 * (o - u) / u : 0)
+  }'
+done
+
+# Cleanup
+rm -f reproducibility_input.txt
@@ -36,7 +36,186 @@ echo -n "Test 5 (Extra data warning): "
 $EXE 3 1 extra_data.txt 2>&1 | grep -q "Warning: extra data found"
 if [ $? -eq 0 ]; then echo "PASS"; else echo "FAIL"; fi
 
+# Test 6: Factor cache (second identical run maps the stored factor; an entry
+# whose digest does not match the input, as after a key collision, is a miss)
+CACHE_DIR=$(mktemp -d)
+echo -n "Test 6 (Factor cache hit): "
+$EXE 200 16 --cache-dir=$CACHE_DIR 2>&1 | grep -q "Factor cache: stored" &&
+  $EXE 200 16 --cache-dir=$CACHE_DIR 2>&1 | grep -q "Factor cache: hit" &&
+  printf '\xff' | dd of=$(ls $CACHE_DIR/*.fac) bs=1 seek=32 conv=notrunc 2>/dev/null &&
+  $EXE 200 16 --cache-dir=$CACHE_DIR 2>&1 | grep -q "Factor cache: stored"
+if [ $? -eq 0 ]; then echo "PASS"; else echo "FAIL"; fi
+
+# Test 7: Daemon mode (concurrent solves against one resident factor are batched)
+SOCKET=$CACHE_DIR/solver.sock
+$EXE --daemon=$SOCKET --batch-window-us=20000 >/dev/null &
+echo -n "Test 7 (Daemon batched solves): "
+python3 - "$SOCKET" "$CACHE_DIR" <<'PYEOF' 2>/dev/null | grep -q "^batched-ok$"
+import os, select, socket, struct, sys, time
+sock_path, work_dir, n = sys.argv[1], sys.argv[2], 64
+for _ in range(100):
+    if os.path.exists(sock_path):
+        break
+    time.sleep(0.05)
+def connect():
+    s = socket.socket(socket.AF_UNIX)
+    s.connect(sock_path)
+    return s
+control = connect()
+control.sendall(b"FACTOR a 64 8 generate\n")
+assert control.makefile().readline().startswith("OK")
+paths, clients = [], [connect() for _ in range(3)]
+for r, client in enumerate(clients):
+    b = [sum((n - max(i, j)) * (r + 1.0) for j in range(n)) for i in range(n)]
+    paths.append(os.path.join(work_dir, "rhs%d" % r))
+    open(paths[-1], "wb").write(struct.pack("%dd" % n, *b))
+    client.sendall(("SOLVE a %s\n" % paths[-1]).encode())
+replies = [client.makefile().readline() for client in clients]
+errors = [max(abs(v - r - 1) for v in struct.unpack("%dd" % n, open(p, "rb").read()))
+          for r, p in enumerate(paths)]
+# A solve against "a" is answered while "b" is still being factored, and a
+# missing output path is refused rather than created.
+factoring = connect()
+factoring.sendall(b"FACTOR b 2000 50 generate\n")
+time.sleep(0.05)
+clients[0].sendall(("SOLVE a %s\n" % paths[0]).encode())
+clients[1].sendall(("SOLVE a %s %s\n" % (paths[1], paths[1] + ".missing")).encode())
+overlapped = clients[0].makefile().readline().startswith("OK")
+overlapped = overlapped and not select.select([factoring], [], [], 0)[0]
+refused = clients[1].makefile().readline().startswith("ERROR")
+overlapped = overlapped and factoring.makefile().readline().startswith("OK")
+control.sendall(b"SHUTDOWN\n")
+control.makefile().readline()
+if (all("batch=3" in reply for reply in replies) and max(errors) < 1e-8 and overlapped and
+        refused and not os.path.exists(paths[1] + ".missing")):
+    print("batched-ok")
+PYEOF
+if [ $? -eq 0 ]; then echo "PASS"; else echo "FAIL"; fi
+wait
+
+# Test 8: Symmetric indefinite system with a zero diagonal (needs pivoting)
+printf "0 1 2\n1 0 3\n2 3 0\n" > kkt.txt
+echo -n "Test 8 (Indefinite system in ldlt mode): "
+$EXE 3 1 kkt.txt 2>&1 | grep -q "Solver failed" &&
+  $EXE --mode=ldlt 3 1 kkt.txt 2>&1 | grep -q "Error: 0.00000e+00"
+if [ $? -eq 0 ]; then echo "PASS"; else echo "FAIL"; fi
+
+# Test 9: Generator families are accurate and independent of the thread count
+echo -n "Test 9 (Matrix generators): "
+result="PASS"
+for generator in abs random_spd banded laplacian indefinite covariance; do
+  serial=$($EXE --generator=$generator --seed=3 --print-hashes 301 16 2>&1)
+  threaded=$($EXE --generator=$generator --seed=3 --print-hashes --threads=3 301 16 2>&1)
+  [ "$(echo "$serial" | grep "^Hashes:")" == "$(echo "$threaded" | grep "^Hashes:")" ] ||
+    result="FAIL ($generator hashes)"
+  echo "$serial" | awk '/^Error:/ { exit !($2 < 1e-6) }' || result="FAIL ($generator error)"
+done
+echo "$result"
+
+# Test 10: Partial factorization + resume from the Schur complement matches the full one
+echo -n "Test 10 (Schur complement split): "
+full=$($EXE --generator=indefinite --print-hashes 500 32 2>&1 | grep "^Hashes:")
+split=$($EXE --generator=indefinite --print-hashes --split-at=192 500 32 2>&1)
+echo "$split" | grep -q "Schur complement: size=308" &&
+  [ "$(echo "$split" | grep "^Hashes:")" == "$full" ]
+if [ $? -eq 0 ]; then echo "PASS"; else echo "FAIL"; fi
+
+# Test 11: Tile low-rank factorization compresses a covariance matrix and stays accurate,
+# also when the input is streamed from a file (a truncated file is an input error)
+echo -n "Test 11 (TLR compression): "
+output=$($EXE --generator=covariance --tlr=1e-10 600 50 2>&1)
+awk 'BEGIN { for (i = 0; i < 120; ++i) { for (j = 0; j < 120; ++j)
+               printf "%.17g ", exp(-3 * (i > j ? i - j : j - i) / 120) + (i == j ? 0.1 : 0)
+             printf "\n" } }' > tlr_input.txt
+head -60 tlr_input.txt > tlr_truncated.txt
+echo "$output" | awk '/^TLR factor:/ { found = 1; ok = ($NF <= 10) } /^Error:/ { small = ($2 < 1e-6) }
+                      END { exit !(found && ok && small) }' &&
+  $EXE --tlr=1e-10 120 16 tlr_input.txt 2>&1 | awk '/^Error:/ { exit !($2 < 1e-8) }' &&
+  $EXE --tlr=1e-10 120 16 tlr_truncated.txt 2>&1 | grep -q "failed to read element at (60, 0)"
+if [ $? -eq 0 ]; then echo "PASS"; else echo "FAIL"; fi
+rm -f tlr_input.txt tlr_truncated.txt
+
+# Test 12: Incremental extension matches the full factor and stays accurate off the block grid
+echo -n "Test 12 (Bordered extension): "
+full=$($EXE --print-hashes 512 32 2>&1 | grep "^Hashes:")
+extended=$($EXE --print-hashes --extend=64 512 32 2>&1)
+echo "$extended" | grep -q "Extension: 448 -> 512 rows" &&
+  [ "$(echo "$extended" | grep "^Hashes:")" == "$full" ] &&
+  $EXE --generator=indefinite --extend=37 500 32 2>&1 | awk '/^Error:/ { exit !($2 < 1e-8) }'
+if [ $? -eq 0 ]; then echo "PASS"; else echo "FAIL"; fi
+
+# Test 13: Diagonal and full inverse from the factor agree with solves of unit vectors
+echo -n "Test 13 (Inverse from the factor): "
+result="PASS"
+for part in diagonal full; do
+  $EXE --generator=indefinite --inverse=$part 301 32 2>&1 |
+    awk -F= '/^Inverse/ { found = 1; ok = ($NF < 1e-12) } END { exit !(found && ok) }' ||
+    result="FAIL ($part)"
+done
+echo "$result"
+
+# Test 14: The benchmark gate flags a 5% slowdown of a small case (phase times
+# are parsed at nanosecond resolution, not from the centisecond Time: lines)
+echo -n "Test 14 (Regression gate resolution): "
+python3 - "$(dirname "$0")/../benchmarks" <<'PYEOF' >/dev/null 2>&1
+import argparse, statistics, sys
+sys.path.insert(0, sys.argv[1])
+import manager
+measured = manager.measure_case(1000, 64, "cholesky", 3)
+gated = statistics.median(manager.gated_samples(measured))
+assert 0 < gated < 1
+# Synthetic samples around the measured time with 0.5% jitter, then 5% slower.
+jitter = [1.0, 1.005, 0.995, 1.002, 0.998, 1.004, 0.996]
+def case(scale):
+    return {"n": 1000, "block": 64, "mode": "cholesky", "total": [gated * j for j in jitter],
+            "phases": {"initialization": [0.0] * 7, "algorithm": [0.0] * 7,
+                       "decomposition": [manager.parse_phase_times(
+                           "Stage: on cholesky decomposition ns=%d" % (gated * j * scale * 1e9))
+                           ["decomposition"] for j in jitter]},
+            "error": measured["error"], "residual": measured["residual"]}
+args = argparse.Namespace(permutations=2000, seed=1, alpha=0.01, min_slowdown=2.0,
+                          accuracy_factor=10.0, accuracy_floor=1e-14)
+baseline = {"name": "synthetic", "created": "-", "cases": [case(1.0)]}
+assert manager.compare_regression(baseline, [case(1.0)], args)
+assert not manager.compare_regression(baseline, [case(1.05)], args)
+PYEOF
+if [ $? -eq 0 ]; then echo "PASS"; else echo "FAIL"; fi
+
+# Test 15: The daemon stops at SHUTDOWN (a later queued SOLVE is refused, not
+# batched with an earlier one) and never deletes a regular file at its path
+echo -n "Test 15 (Daemon shutdown barrier): "
+SOCKET=$CACHE_DIR/barrier.sock
+echo "keep" > $CACHE_DIR/not_a_socket
+timeout 5 $EXE --daemon=$CACHE_DIR/not_a_socket 2>&1 | grep -q "is not a socket" &&
+  grep -q "keep" $CACHE_DIR/not_a_socket
+status=$?
+$EXE --daemon=$SOCKET --batch-window-us=20000 >/dev/null &
+python3 - "$SOCKET" "$CACHE_DIR" <<'PYEOF' 2>/dev/null | grep -q "^barrier-ok$"
+import os, socket, struct, sys, time
+sock_path, work_dir, n = sys.argv[1], sys.argv[2], 16
+for _ in range(100):
+    if os.path.exists(sock_path):
+        break
+    time.sleep(0.05)
+s = socket.socket(socket.AF_UNIX)
+s.connect(sock_path)
+replies = s.makefile()
+s.sendall(b"FACTOR a 16 4 generate\n")
+assert replies.readline().startswith("OK")
+paths = [os.path.join(work_dir, "barrier%d" % r) for r in range(2)]
+for path in paths:
+    open(path, "wb").write(struct.pack("%dd" % n, *([1.0] * n)))
+s.sendall(("SOLVE a %s\nSHUTDOWN\nSOLVE a %s\n" % tuple(paths)).encode())
+lines = [replies.readline() for _ in range(3)]
+if (lines[0].startswith("OK solve a batch=1") and lines[1].startswith("OK shutdown") and
+        lines[2].startswith("ERROR shutting down")):
+    print("barrier-ok")
+PYEOF
+if [ $? -eq 0 ] && [ $status -eq 0 ]; then echo "PASS"; else echo "FAIL"; fi
+wait
+
 # Cleanup
-rm malformed.txt extra_data.txt
+rm malformed.txt extra_data.txt kkt.txt
+rm -rf $CACHE_DIR
 
 echo "Robustness tests completed."